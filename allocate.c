@@ -118,6 +118,20 @@ void *allocate(struct allocator_struct *desc, unsigned int size)
 	return retval;
 }
 
+/*
+ * Make room in a malloc()ed array holding "nr" entries for one more:
+ * it grows by doubling, so the cost is amortized constant per entry.
+ */
+void *grow_array(void *array, unsigned long nr, size_t size)
+{
+	if (nr && (nr < 16 || (nr & (nr - 1))))
+		return array;
+	array = realloc(array, (nr ? 2 * nr : 16) * size);
+	if (!array)
+		die("out of memory");
+	return array;
+}
+
 void show_allocations(struct allocator_struct *x)
 {
 	fprintf(stderr, "%s: %d allocations, %d bytes (%d total bytes, "
@@ -131,6 +145,7 @@ ALLOCATOR(ident, "identifiers");
 ALLOCATOR(token, "tokens");
 ALLOCATOR(context, "contexts");
 ALLOCATOR(symbol, "symbols");
+ALLOCATOR(symbol_cold, "cold symbol parts");
 ALLOCATOR(expression, "expressions");
 ALLOCATOR(statement, "statements");
 ALLOCATOR(string, "strings");
@@ -7,6 +7,9 @@
 /* Every bitmap gets its own type */
 #define DECLARE_BITMAP(name, x) unsigned long name[LONGS(x)]
 
+/* Number of longs needed by a dynamically allocated bitmap */
+#define BITMAP_LONGS(x)	(((x) + BITS_IN_LONG - 1) / BITS_IN_LONG)
+
 static inline int test_bit(unsigned int nr, unsigned long *bitmap)
 {
 	unsigned long offset = nr / BITS_IN_LONG;
@@ -29,84 +29,138 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <assert.h>
-#include <libxml/parser.h>
-#include <libxml/tree.h>
 
 #include "expression.h"
 #include "parse.h"
 #include "scope.h"
 #include "symbol.h"
 
-static xmlDocPtr doc = NULL;       /* document pointer */
-static xmlNodePtr root_node = NULL;/* root node pointer */
+/*
+ * The document is written out as we go: a symbol element is finished
+ * as soon as examine_symbol() is done with it, and only the elements
+ * still open are remembered. A type that is first referred to from
+ * inside an element gets its id right away, and is written at the top
+ * level once that element is closed.
+ *
+ * sym->aux holds the id of a symbol, plus one.
+ */
 static int idcount = 0;
+static int depth = 0;		/* open elements, <parse> included */
+static int start_open = 0;	/* the innermost start tag isn't closed yet */
+static struct symbol_vec pending;
+
+static void examine_symbol(struct symbol *sym);
+static void write_symbol(struct symbol *sym);
+
+static void open_element(const char *name)
+{
+	if (start_open)
+		printf(">\n");
+	printf("%*s<%s", 2 * depth, "", name);
+	start_open = 1;
+	depth++;
+}
 
-static void examine_symbol(struct symbol *sym, xmlNodePtr node);
+static void close_element(const char *name)
+{
+	depth--;
+	if (start_open)
+		printf("/>\n");
+	else
+		printf("%*s</%s>\n", 2 * depth, "", name);
+	start_open = 0;
+}
 
-static xmlAttrPtr newProp(xmlNodePtr node, const char *name, const char *value)
+static void newProp(const char *name, const char *value)
 {
-	return xmlNewProp(node, BAD_CAST name, BAD_CAST value);
+	const char *p;
+
+	printf(" %s=\"", name);
+	for (p = value; *p; p++) {
+		switch (*p) {
+		case '<':  fputs("&lt;", stdout); break;
+		case '>':  fputs("&gt;", stdout); break;
+		case '&':  fputs("&amp;", stdout); break;
+		case '"':  fputs("&quot;", stdout); break;
+		case '\n': fputs("&#10;", stdout); break;
+		case '\r': fputs("&#13;", stdout); break;
+		case '\t': fputs("&#9;", stdout); break;
+		default:   putchar(*p);
+		}
+	}
+	putchar('"');
 }
 
-static xmlAttrPtr newNumProp(xmlNodePtr node, const char *name, int value)
+static void newNumProp(const char *name, int value)
 {
 	char buf[256];
 	snprintf(buf, 256, "%d", value);
-	return newProp(node, name, buf);
+	newProp(name, buf);
 }
 
-static xmlAttrPtr newIdProp(xmlNodePtr node, const char *name, unsigned int id)
+static void newIdProp(const char *name, unsigned int id)
 {
 	char buf[256];
 	snprintf(buf, 256, "_%d", id);
-	return newProp(node, name, buf);
+	newProp(name, buf);
+}
+
+static unsigned int symbol_id(struct symbol *sym)
+{
+	if (!sym->aux)
+		sym->aux = (void *)(unsigned long)++idcount;
+	return (unsigned long)sym->aux - 1;
 }
 
-static xmlNodePtr new_sym_node(struct symbol *sym, const char *name, xmlNodePtr parent)
+static void new_sym_node(struct symbol *sym, const char *name)
 {
-	xmlNodePtr node;
 	const char *ident = show_ident(sym->ident);
 
 	assert(name != NULL);
 	assert(sym != NULL);
-	assert(parent != NULL);
 
-	node = xmlNewChild(parent, NULL, BAD_CAST "symbol", NULL);
+	open_element("symbol");
 
-	newProp(node, "type", name);
+	newProp("type", name);
 
-	newIdProp(node, "id", idcount);
+	newIdProp("id", symbol_id(sym));
 
 	if (sym->ident && ident)
-		newProp(node, "ident", ident);
-	newProp(node, "file", stream_name(sym->pos.stream));
+		newProp("ident", ident);
+	newProp("file", stream_name(sym->pos.stream));
 
-	newNumProp(node, "start-line", sym->pos.line);
-	newNumProp(node, "start-col", sym->pos.pos);
+	newNumProp("start-line", sym->pos.line);
+	newNumProp("start-col", sym->pos.pos);
 
 	if (sym->endpos.type) {
-		newNumProp(node, "end-line", sym->endpos.line);
-		newNumProp(node, "end-col", sym->endpos.pos);
+		newNumProp("end-line", sym->endpos.line);
+		newNumProp("end-col", sym->endpos.pos);
 		if (sym->pos.stream != sym->endpos.stream)
-			newProp(node, "end-file", stream_name(sym->endpos.stream));
+			newProp("end-file", stream_name(sym->endpos.stream));
         }
-	sym->aux = node;
+}
 
-	idcount++;
+/* The types referred to from inside the elements just closed */
+static void write_pending(void)
+{
+	struct symbol *sym;
 
-	return node;
+	FOR_EACH_VEC(&pending, sym) {
+		write_symbol(sym);
+	} END_FOR_EACH_VEC(sym);
+	reset_ptr_vec(&pending);
 }
 
-static inline void examine_members(struct symbol_list *list, xmlNodePtr node)
+static inline void examine_members(struct symbol_list *list)
 {
 	struct symbol *sym;
 
 	FOR_EACH_PTR(list, sym) {
-		examine_symbol(sym, node);
+		examine_symbol(sym);
 	} END_FOR_EACH_PTR(sym);
 }
 
-static void examine_modifiers(struct symbol *sym, xmlNodePtr node)
+static void examine_modifiers(struct symbol *sym)
 {
 	const char *modifiers[] = {
 			"auto",
@@ -150,72 +204,76 @@ static void examine_modifiers(struct symbol *sym, xmlNodePtr node)
 	/*iterate over the 32 bit bitfield*/
 	for (i=0; i < 32; i++) {
 		if ((sym->ctype.modifiers & 1<<i) && modifiers[i])
-			newProp(node, modifiers[i], "1");
+			newProp(modifiers[i], "1");
 	}
 }
 
 static void
-examine_layout(struct symbol *sym, xmlNodePtr node)
+examine_layout(struct symbol *sym)
 {
 	examine_symbol_type(sym);
 
-	newNumProp(node, "bit-size", sym->bit_size);
-	newNumProp(node, "alignment", sym->ctype.alignment);
-	newNumProp(node, "offset", sym->offset);
+	newNumProp("bit-size", sym->bit_size);
+	newNumProp("alignment", sym->ctype.alignment);
+	newNumProp("offset", sym->offset);
 	if (is_bitfield_type(sym)) {
-		newNumProp(node, "bit-offset", sym->bit_offset);
+		newNumProp("bit-offset", sym->bit_offset);
 	}
 }
 
-static void examine_symbol(struct symbol *sym, xmlNodePtr node)
+static void write_symbol(struct symbol *sym)
 {
-	xmlNodePtr child = NULL;
+	struct symbol *base_type;
 	const char *base;
 	int array_size;
 
-	if (!sym)
-		return;
-	if (sym->aux)		/*already visited */
-		return;
-
-	if (sym->ident && sym->ident->reserved)
-		return;
+	new_sym_node(sym, get_type_name(sym->type));
+	examine_modifiers(sym);
+	examine_layout(sym);
 
-	child = new_sym_node(sym, get_type_name(sym->type), node);
-	examine_modifiers(sym, child);
-	examine_layout(sym, child);
-
-	if (sym->ctype.base_type) {
-		if ((base = builtin_typename(sym->ctype.base_type)) == NULL) {
-			if (!sym->ctype.base_type->aux) {
-				examine_symbol(sym->ctype.base_type, root_node);
-			}
-			xmlNewProp(child, BAD_CAST "base-type",
-			           xmlGetProp((xmlNodePtr)sym->ctype.base_type->aux, BAD_CAST "id"));
+	base_type = sym->ctype.base_type;
+	if (base_type) {
+		if ((base = builtin_typename(base_type)) == NULL) {
+			if (!base_type->aux)
+				add_ptr_vec(&pending, base_type);
+			newIdProp("base-type", symbol_id(base_type));
 		} else {
-			newProp(child, "base-type-builtin", base);
+			newProp("base-type-builtin", base);
 		}
 	}
-	if (sym->array_size) {
+	if (cold_field(sym, array_size)) {
 		/* TODO: modify get_expression_value to give error return */
-		array_size = get_expression_value(sym->array_size);
-		newNumProp(child, "array-size", array_size);
+		array_size = get_expression_value(sym->cold->array_size);
+		newNumProp("array-size", array_size);
 	}
 
 
 	switch (sym->type) {
 	case SYM_STRUCT:
 	case SYM_UNION:
-		examine_members(sym->symbol_list, child);
+		examine_members(sym->symbol_list);
 		break;
 	case SYM_FN:
-		examine_members(sym->arguments, child);
+		examine_members(sym->arguments);
 		break;
 	case SYM_UNINITIALIZED:
-		newProp(child, "base-type-builtin", builtin_typename(sym));
+		newProp("base-type-builtin", builtin_typename(sym));
 		break;
 	}
-	return;
+	close_element("symbol");
+}
+
+static void examine_symbol(struct symbol *sym)
+{
+	if (!sym)
+		return;
+	if (sym->aux)		/*already visited */
+		return;
+
+	if (sym->ident && sym->ident->reserved)
+		return;
+
+	write_symbol(sym);
 }
 
 static struct position *get_expansion_end (struct token *token)
@@ -232,7 +290,7 @@ static struct position *get_expansion_end (struct token *token)
 		return NULL;
 }
 
-static void examine_macro(struct symbol *sym, xmlNodePtr node)
+static void examine_macro(struct symbol *sym)
 {
 	struct position *pos;
 
@@ -243,7 +301,8 @@ static void examine_macro(struct symbol *sym, xmlNodePtr node)
 	else
 		sym->endpos = sym->pos;
 
-	new_sym_node(sym, "macro", node);
+	new_sym_node(sym, "macro");
+	close_element("symbol");
 }
 
 static void examine_namespace(struct symbol *sym)
@@ -253,12 +312,13 @@ static void examine_namespace(struct symbol *sym)
 
 	switch(sym->namespace) {
 	case NS_MACRO:
-		examine_macro(sym, root_node);
+		examine_macro(sym);
 		break;
 	case NS_TYPEDEF:
 	case NS_STRUCT:
 	case NS_SYMBOL:
-		examine_symbol(sym, root_node);
+		examine_symbol(sym);
+		write_pending();
 		break;
 	case NS_NONE:
 	case NS_LABEL:
@@ -302,18 +362,9 @@ int main(int argc, char **argv)
 	struct symbol_list *symlist = NULL;
 	char *file;
 
-	doc = xmlNewDoc(BAD_CAST "1.0");
-	root_node = xmlNewNode(NULL, BAD_CAST "parse");
-	xmlDocSetRootElement(doc, root_node);
-
-/* - A DTD is probably unnecessary for something like this
-
-	dtd = xmlCreateIntSubset(doc, "parse", "http://www.kernel.org/pub/software/devel/sparse/parse.dtd" NULL, "parse.dtd");
+	printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	open_element("parse");
 
-	ns = xmlNewNs (root_node, "http://www.kernel.org/pub/software/devel/sparse/parse.dtd", NULL);
-
-	xmlSetNs(root_node, ns);
-*/
 	symlist = sparse_initialize(argc, argv, &filelist);
 
 	FOR_EACH_PTR_NOTAG(filelist, file) {
@@ -323,10 +374,7 @@ int main(int argc, char **argv)
 		examine_symbol_list(file, global_scope->symbols);
 	} END_FOR_EACH_PTR_NOTAG(file);
 
-
-	xmlSaveFormatFileEnc("-", doc, "UTF-8", 1);
-	xmlFreeDoc(doc);
-	xmlCleanupParser();
+	close_element("parse");
 
 	return 0;
 }
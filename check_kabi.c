@@ -285,18 +285,16 @@ long unsigned int process_enum(struct symbol *sym, long unsigned int crc, int is
 
 long unsigned int process_struct(struct symbol *sym, long unsigned int crc, int is_fn_param)
 {
-    int member_count = 0;
     struct symbol_list *members = sym->symbol_list;
     struct symbol *member;
 
     crc = crc32("{", crc);
     FOR_EACH_PTR(members, member) {
-        member_count = member_count + 1;
         alloc_parsym(sym, SYM_STRUCT);
         crc = process_symbol(member, crc, is_fn_param);
         crc = crc32(";", crc);
     }END_FOR_EACH_PTR(member);
-    if (member_count == 0) {
+    if (symbol_list_size(members) == 0) {
         crc = crc32("UNKNOWN", crc);
     }
     crc = crc32("}", crc);
@@ -362,7 +360,7 @@ long unsigned int process_array(struct symbol *sym, long unsigned int crc, int i
     struct symbol *subsym = sym->ctype.base_type;
     enum type subsymtype = sym->ctype.base_type->type;
 
-    sprintf(array_size, "%lld", get_expression_value_silent(sym->array_size));
+    sprintf(array_size, "%lld", get_expression_value_silent(cold_field(sym, array_size)));
     switch(subsymtype) {
         case SYM_PTR:
             subsym->ident = sym->ident;
@@ -488,7 +486,7 @@ long unsigned int process_symbol_using_typedef(struct symbol *sym, long unsigned
 
     if (sym->ctype.base_type->type == SYM_ARRAY) {
         char array_size[256];
-        sprintf(array_size, "%lld", get_expression_value_silent(sym->ctype.base_type->array_size));
+        sprintf(array_size, "%lld", get_expression_value_silent(cold_field(sym->ctype.base_type, array_size)));
         crc = crc32("[", crc);
         if (strcmp(array_size, "0") != 0)
             crc = crc32(array_size, crc);
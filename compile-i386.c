@@ -157,15 +157,18 @@ enum atom_type {
 	ATOM_TEXT,
 	ATOM_INSN,
 	ATOM_CSTR,
+	ATOM_LABEL,
 };
 
 struct atom {
 	enum atom_type type;
 	union {
-		/* stuff for text */
+		/* stuff for text (and labels) */
 		struct {
 			char *text;
 			unsigned int text_len;  /* w/o terminating null */
+			int text_label;
+			struct symbol *text_labelsym;
 		};
 
 		/* stuff for insns */
@@ -496,7 +499,7 @@ static inline void push_atom(struct function *f, struct atom *atom)
 	add_ptr_list(&f->atom_list, atom);
 }
 
-static void push_text_atom(struct function *f, const char *text)
+static struct atom *push_text_atom(struct function *f, const char *text)
 {
 	struct atom *atom = new_atom(ATOM_TEXT);
 
@@ -504,6 +507,7 @@ static void push_text_atom(struct function *f, const char *text)
 	atom->text_len = strlen(text);
 
 	push_atom(f, atom);
+	return atom;
 }
 
 static struct storage *new_storage(enum storage_type type)
@@ -660,6 +664,7 @@ static void emit_comment(const char *fmt, ...)
 static void emit_label (int label, const char *comment)
 {
 	struct function *f = current_func;
+	struct atom *atom;
 	char s[64];
 
 	if (!comment)
@@ -667,12 +672,15 @@ static void emit_label (int label, const char *comment)
 	else
 		sprintf(s, ".L%d:\t\t\t\t\t# %s\n", label, comment);
 
-	push_text_atom(f, s);
+	atom = push_text_atom(f, s);
+	atom->type = ATOM_LABEL;
+	atom->text_label = label;
 }
 
 static void emit_labelsym (struct symbol *sym, const char *comment)
 {
 	struct function *f = current_func;
+	struct atom *atom;
 	char s[64];
 
 	if (!comment)
@@ -680,7 +688,9 @@ static void emit_labelsym (struct symbol *sym, const char *comment)
 	else
 		sprintf(s, ".LS%p:\t\t\t\t# %s\n", sym, comment);
 
-	push_text_atom(f, s);
+	atom = push_text_atom(f, s);
+	atom->type = ATOM_LABEL;
+	atom->text_labelsym = sym;
 }
 
 void emit_unit_begin(const char *basename)
@@ -741,7 +751,8 @@ static void emit_atom_list(struct function *f)
 
 	FOR_EACH_PTR(f->atom_list, atom) {
 		switch (atom->type) {
-		case ATOM_TEXT: {
+		case ATOM_TEXT:
+		case ATOM_LABEL: {
 			ssize_t rc = write(STDOUT_FILENO, atom->text,
 					   atom->text_len);
 			(void) rc;	/* FIXME */
@@ -772,19 +783,408 @@ static void emit_string_list(struct function *f)
 	} END_FOR_EACH_PTR(atom);
 }
 
+static void free_atom(struct atom *atom)
+{
+	switch (atom->type) {
+	case ATOM_TEXT:
+	case ATOM_LABEL:
+		free(atom->text);
+		break;
+	case ATOM_INSN:
+		if (atom->op1 && (atom->op1->flags & STOR_WANTS_FREE))
+			free(atom->op1);
+		if (atom->op2 && (atom->op2->flags & STOR_WANTS_FREE))
+			free(atom->op2);
+		break;
+	case ATOM_CSTR:
+		break;
+	}
+	free(atom);
+}
+
+/*
+ * A few peephole rewrites of the atom list of a function, run
+ * before it is written out.  The code generator works one
+ * expression at a time and leaves a lot of shuffling behind:
+ *
+ *	mov X, X			-> (deleted)
+ *	mov A, B; mov A, B		-> mov A, B
+ *	mov A, B; mov B, A		-> mov A, B
+ *	mov A, M; mov M, %r		-> mov A, M; mov A, %r
+ *	j* L ... L: jmp M		-> j* M
+ *	jmp L; L:			-> L:
+ *	jmp/ret; <no label> insns	-> jmp/ret
+ *	.Ln: (never referenced)		-> (deleted)
+ *
+ * Everything that can be jumped to is a label atom (the user's labels
+ * included), so code after a jmp is dead up to the next one.
+ */
+struct label_pos {
+	struct symbol *sym;
+	int label;
+	int pos;
+};
+
+static int label_pos_cmp(const void *_a, const void *_b)
+{
+	const struct label_pos *a = _a, *b = _b;
+
+	if (a->sym != b->sym)
+		return a->sym < b->sym ? -1 : 1;
+	return a->label - b->label;
+}
+
+struct peephole {
+	struct atom **atoms;
+	int nr;
+	struct label_pos *labels;
+	int nr_labels;
+	int *refs;		/* references to each numbered label */
+	int max_label;
+};
+
+static int is_insn(struct atom *atom, const char *name)
+{
+	return atom && atom->type == ATOM_INSN && !strcmp(atom->insn, name);
+}
+
+static int is_plain_move(struct atom *atom)
+{
+	static const char *moves[] = { "mov", "movb", "movw", "movl" };
+	int i;
+
+	if (!atom || atom->type != ATOM_INSN || !atom->op1 || !atom->op2)
+		return 0;
+	for (i = 0; i < ARRAY_SIZE(moves); i++)
+		if (!strcmp(atom->insn, moves[i]))
+			return 1;
+	return 0;
+}
+
+static struct storage *jump_target(struct atom *atom)
+{
+	struct storage *op;
+
+	if (!atom || atom->type != ATOM_INSN || atom->insn[0] != 'j')
+		return NULL;
+	op = atom->op1;
+	if (!op || atom->op2 || (op->flags & STOR_LABEL_VAL))
+		return NULL;
+	if (op->type != STOR_LABEL && op->type != STOR_LABELSYM)
+		return NULL;
+	return op;
+}
+
+static int is_unconditional(struct atom *atom)
+{
+	return is_insn(atom, "ret") || (is_insn(atom, "jmp") && jump_target(atom));
+}
+
+static int same_storage(struct storage *a, struct storage *b)
+{
+	if (a == b)
+		return 1;
+	if (!a || !b || a->type != b->type)
+		return 0;
+
+	switch (a->type) {
+	case STOR_PSEUDO:
+		return a->offset == b->offset;
+	case STOR_ARG:
+		return a->idx == b->idx;
+	case STOR_SYM:
+		return a->sym == b->sym;
+	case STOR_REG:
+		return a->reg == b->reg;
+	case STOR_VALUE:
+		return a->value == b->value;
+	case STOR_LABEL:
+		return a->label == b->label &&
+		       (a->flags & STOR_LABEL_VAL) == (b->flags & STOR_LABEL_VAL);
+	case STOR_LABELSYM:
+		return a->labelsym == b->labelsym &&
+		       (a->flags & STOR_LABEL_VAL) == (b->flags & STOR_LABEL_VAL);
+	}
+	return 0;
+}
+
+static int is_memory(struct storage *s)
+{
+	return s->type == STOR_PSEUDO || s->type == STOR_ARG ||
+	       s->type == STOR_SYM;
+}
+
+/* a private copy of an operand, for an atom to own and free */
+static struct storage *copy_storage(struct storage *s)
+{
+	struct storage *new = new_storage(s->type);
+
+	*new = *s;
+	new->flags |= STOR_WANTS_FREE;
+	return new;
+}
+
+static void set_operand(struct storage **op, struct storage *s)
+{
+	if ((*op)->flags & STOR_WANTS_FREE)
+		free(*op);
+	*op = (s->flags & STOR_WANTS_FREE) ? copy_storage(s) : s;
+}
+
+static void delete_atom(struct peephole *p, int i)
+{
+	free_atom(p->atoms[i]);
+	p->atoms[i] = NULL;
+}
+
+/* what emit_comment() pushes, as opposed to raw instruction text */
+static int is_comment(struct atom *atom)
+{
+	return atom->type == ATOM_TEXT && !strncmp(atom->text, "\t# ", 3);
+}
+
+/*
+ * The next atom after i, skipping comments. Any other text is some
+ * instruction we know nothing about and is returned as is, for the
+ * callers to stop at.
+ */
+static int next_atom(struct peephole *p, int i)
+{
+	while (++i < p->nr) {
+		struct atom *atom = p->atoms[i];
+		if (atom && !is_comment(atom))
+			return i;
+	}
+	return -1;
+}
+
+static int next_insn(struct peephole *p, int i)
+{
+	while ((i = next_atom(p, i)) >= 0 && p->atoms[i]->type == ATOM_LABEL)
+		;
+	return i;
+}
+
+static void index_labels(struct peephole *p)
+{
+	int i, n = 0;
+
+	memset(p->refs, 0, (p->max_label + 1) * sizeof(*p->refs));
+	for (i = 0; i < p->nr; i++) {
+		struct atom *atom = p->atoms[i];
+
+		if (!atom)
+			continue;
+		if (atom->type == ATOM_LABEL) {
+			p->labels[n].sym = atom->text_labelsym;
+			p->labels[n].label = atom->text_label;
+			p->labels[n].pos = i;
+			n++;
+		} else if (atom->type == ATOM_INSN) {
+			if (atom->op1 && atom->op1->type == STOR_LABEL &&
+			    atom->op1->label <= p->max_label)
+				p->refs[atom->op1->label]++;
+			if (atom->op2 && atom->op2->type == STOR_LABEL &&
+			    atom->op2->label <= p->max_label)
+				p->refs[atom->op2->label]++;
+		}
+	}
+	p->nr_labels = n;
+	qsort(p->labels, n, sizeof(*p->labels), label_pos_cmp);
+}
+
+static int find_label(struct peephole *p, struct storage *target)
+{
+	struct label_pos key = { }, *found;
+
+	if (target->type == STOR_LABELSYM)
+		key.sym = target->labelsym;
+	else
+		key.label = target->label;
+	found = bsearch(&key, p->labels, p->nr_labels, sizeof(key),
+			label_pos_cmp);
+	return found ? found->pos : -1;
+}
+
+/*
+ * Where a jump to "target" ends up once the chain of jmps it may land
+ * on is followed, or NULL if that is "target" itself or if the chain
+ * loops.
+ */
+static struct storage *final_target(struct peephole *p, struct storage *target)
+{
+	struct storage *final = NULL;
+	int steps = 0;
+
+	for (;;) {
+		int pos = find_label(p, target);
+		struct storage *next;
+
+		if (pos < 0)
+			break;
+		pos = next_insn(p, pos);
+		if (pos < 0 || !is_insn(p->atoms[pos], "jmp"))
+			break;
+		next = jump_target(p->atoms[pos]);
+		if (!next || ++steps > p->nr_labels)
+			return NULL;
+		final = target = next;
+	}
+	return final;
+}
+
+static int peephole_moves(struct peephole *p, int i)
+{
+	struct atom *atom = p->atoms[i], *next;
+	int j;
+
+	if (same_storage(atom->op1, atom->op2)) {
+		delete_atom(p, i);
+		return 1;
+	}
+
+	j = next_atom(p, i);
+	if (j < 0 || !is_plain_move(p->atoms[j]))
+		return 0;
+	next = p->atoms[j];
+	if (strcmp(atom->insn, next->insn))
+		return 0;
+
+	/* the same move again, or one moving the value straight back */
+	if ((same_storage(atom->op1, next->op1) &&
+	     same_storage(atom->op2, next->op2)) ||
+	    (same_storage(atom->op1, next->op2) &&
+	     same_storage(atom->op2, next->op1))) {
+		delete_atom(p, j);
+		return 1;
+	}
+
+	/* a load of what was just stored */
+	if (is_memory(atom->op2) && same_storage(atom->op2, next->op1) &&
+	    next->op2->type == STOR_REG &&
+	    (atom->op1->type == STOR_REG || atom->op1->type == STOR_VALUE)) {
+		set_operand(&next->op1, atom->op1);
+		return 1;
+	}
+	return 0;
+}
+
+static int peephole_jumps(struct peephole *p, int i)
+{
+	struct atom *atom = p->atoms[i];
+	struct storage *target = jump_target(atom), *final;
+	int changed = 0, j;
+
+	if (target) {
+		final = final_target(p, target);
+		if (final && !same_storage(final, target)) {
+			set_operand(&atom->op1, final);
+			target = atom->op1;
+			changed = 1;
+		}
+
+		/* a jump to where we would fall through anyway */
+		for (j = next_atom(p, i); j >= 0; j = next_atom(p, j)) {
+			struct atom *label = p->atoms[j];
+
+			if (label->type != ATOM_LABEL)
+				break;
+			if (label->text_labelsym ?
+			    target->type == STOR_LABELSYM &&
+			    target->labelsym == label->text_labelsym :
+			    target->type == STOR_LABEL &&
+			    target->label == label->text_label) {
+				delete_atom(p, i);
+				return 1;
+			}
+		}
+	}
+
+	if (!is_unconditional(atom))
+		return changed;
+
+	/* nothing can reach what follows, up to the next label */
+	for (j = next_atom(p, i); j >= 0; j = next_atom(p, j)) {
+		if (p->atoms[j]->type == ATOM_LABEL)
+			break;
+		delete_atom(p, j);
+		changed = 1;
+	}
+	return changed;
+}
+
+static int peephole_labels(struct peephole *p)
+{
+	int i, changed = 0;
+
+	for (i = 0; i < p->nr; i++) {
+		struct atom *atom = p->atoms[i];
+
+		if (!atom || atom->type != ATOM_LABEL || atom->text_labelsym)
+			continue;
+		if (atom->text_label <= p->max_label && p->refs[atom->text_label])
+			continue;
+		delete_atom(p, i);
+		changed = 1;
+	}
+	return changed;
+}
+
+static void peephole(struct function *f)
+{
+	struct peephole p = { };
+	struct atom *atom;
+	int changed, i;
+
+	p.nr = ptr_list_size((struct ptr_list *)f->atom_list);
+	if (!p.nr)
+		return;
+	p.atoms = malloc(p.nr * sizeof(*p.atoms));
+	p.labels = malloc(p.nr * sizeof(*p.labels));
+	if (!p.atoms || !p.labels)
+		die("OOM in peephole");
+
+	i = 0;
+	FOR_EACH_PTR(f->atom_list, atom) {
+		p.atoms[i++] = atom;
+		if (atom->type == ATOM_LABEL && atom->text_label > p.max_label)
+			p.max_label = atom->text_label;
+	} END_FOR_EACH_PTR(atom);
+	p.refs = malloc((p.max_label + 1) * sizeof(*p.refs));
+	if (!p.refs)
+		die("OOM in peephole");
+
+	do {
+		changed = 0;
+		index_labels(&p);
+		for (i = 0; i < p.nr; i++) {
+			atom = p.atoms[i];
+			if (is_plain_move(atom))
+				changed |= peephole_moves(&p, i);
+			else if (jump_target(atom) || is_insn(atom, "ret"))
+				changed |= peephole_jumps(&p, i);
+		}
+		index_labels(&p);
+		changed |= peephole_labels(&p);
+	} while (changed);
+
+	free_ptr_list(&f->atom_list);
+	for (i = 0; i < p.nr; i++)
+		if (p.atoms[i])
+			add_ptr_list(&f->atom_list, p.atoms[i]);
+
+	free(p.atoms);
+	free(p.labels);
+	free(p.refs);
+}
+
 static void func_cleanup(struct function *f)
 {
 	struct storage *stor;
 	struct atom *atom;
 
 	FOR_EACH_PTR(f->atom_list, atom) {
-		if ((atom->type == ATOM_TEXT) && (atom->text))
-			free(atom->text);
-		if (atom->op1 && (atom->op1->flags & STOR_WANTS_FREE))
-			free(atom->op1);
-		if (atom->op2 && (atom->op2->flags & STOR_WANTS_FREE))
-			free(atom->op2);
-		free(atom);
+		free_atom(atom);
 	} END_FOR_EACH_PTR(atom);
 
 	FOR_EACH_PTR(f->pseudo_list, stor) {
@@ -885,6 +1285,8 @@ static void emit_func_post(struct symbol *sym)
 
 	insn("ret", NULL, NULL, NULL);
 
+	peephole(f);
+
 	/* output everything to stdout */
 	fflush(stdout);		/* paranoia; needed? */
 	emit_atom_list(f);
@@ -969,7 +1371,7 @@ static void emit_initializer(struct symbol *sym,
 		struct symbol *base_type = sym->ctype.base_type;
 		assert(base_type != NULL);
 
-		emit_scalar(expr, sym->bit_size / get_expression_value(base_type->array_size));
+		emit_scalar(expr, sym->bit_size / get_expression_value(cold_field(base_type, array_size)));
 		return;
 	}
 	if (expr->type != EXPR_INITIALIZER)
@@ -1133,7 +1535,7 @@ static void emit_array_noinit(struct symbol *sym)
 {
 	emit_global_noinit(show_ident(sym->ident),
 			   sym->ctype.modifiers, sym->ctype.alignment,
-			   get_expression_value(sym->array_size) * (sym->bit_size / 8));
+			   get_expression_value(cold_field(sym, array_size)) * (sym->bit_size / 8));
 	stor_sym_init(sym);
 }
 
@@ -2035,7 +2437,7 @@ static struct storage *x86_statement(struct statement *stmt)
 		break;
 
 	case STMT_LABEL:
-		printf(".L%p:\n", stmt->label_identifier);
+		emit_labelsym(stmt->label_identifier, NULL);
 		x86_statement(stmt->label_statement);
 		break;
 
@@ -2278,7 +2680,7 @@ static int type_is_signed(struct symbol *sym)
 static struct storage *x86_label_expr(struct expression *expr)
 {
 	struct storage *new = stack_alloc(4);
-	printf("\tmovi.%d\t\tv%d,.L%p\n", bits_in_pointer, new->pseudo, expr->label_symbol);
+	printf("\tmovi.%d\t\tv%d,.LS%p\n", bits_in_pointer, new->pseudo, expr->label_symbol);
 	return new;
 }
 
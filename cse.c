@@ -17,11 +17,42 @@
 #include "linearize.h"
 #include "flow.h"
 
-#define INSN_HASH_SIZE 256
-static struct instruction_list *insn_hash_table[INSN_HASH_SIZE];
-
 int repeat_phase;
 
+/*
+ * Only the first pass of cleanup_and_cse() goes over the whole
+ * function. After that, just the instructions that may simplify
+ * differently get looked at again: the ones whose operands changed,
+ * whose users went away, or whose own operands got simplified. They
+ * are queued here by the pseudo usage helpers while 'cse_tracking'
+ * is set, and run through the value numbering again once simplified.
+ */
+int cse_tracking;
+static struct instruction_vec cse_worklist, cse_todo;
+
+static void cse_queue_users(pseudo_t pseudo)
+{
+	struct pseudo_user *pu;
+
+	if (!has_use_list(pseudo))
+		return;
+	FOR_EACH_PTR(pseudo->users, pu) {
+		cse_queue_insn(pu->insn);
+	} END_FOR_EACH_PTR(pu);
+}
+
+void cse_queue_insn(struct instruction *insn)
+{
+	if (!insn || !insn->bb || insn->queued)
+		return;
+	insn->queued = 1;
+	add_ptr_vec(&cse_worklist, insn);
+
+	/* A phi-node hashes on its sources */
+	if (insn->opcode == OP_PHISOURCE)
+		cse_queue_users(insn->target);
+}
+
 static int phi_compare(pseudo_t phi1, pseudo_t phi2)
 {
 	const struct instruction *def1 = phi1->def;
@@ -37,102 +68,18 @@ static int phi_compare(pseudo_t phi1, pseudo_t phi2)
 
 static void clean_up_one_instruction(struct basic_block *bb, struct instruction *insn)
 {
-	unsigned long hash;
+	int changed;
 
 	if (!insn->bb)
 		return;
 	assert(insn->bb == bb);
-	repeat_phase |= simplify_instruction(insn);
-	hash = (insn->opcode << 3) + (insn->size >> 3);
-	switch (insn->opcode) {
-	case OP_SEL:
-		hash += hashval(insn->src3);
-		/* Fall through */	
-
-	/* Binary arithmetic */
-	case OP_ADD: case OP_SUB:
-	case OP_MULU: case OP_MULS:
-	case OP_DIVU: case OP_DIVS:
-	case OP_MODU: case OP_MODS:
-	case OP_SHL:
-	case OP_LSR: case OP_ASR:
-	case OP_AND: case OP_OR:
-
-	/* Binary logical */
-	case OP_XOR: case OP_AND_BOOL:
-	case OP_OR_BOOL:
-
-	/* Binary comparison */
-	case OP_SET_EQ: case OP_SET_NE:
-	case OP_SET_LE: case OP_SET_GE:
-	case OP_SET_LT: case OP_SET_GT:
-	case OP_SET_B:  case OP_SET_A:
-	case OP_SET_BE: case OP_SET_AE:
-		hash += hashval(insn->src2);
-		/* Fall through */
-	
-	/* Unary */
-	case OP_NOT: case OP_NEG:
-		hash += hashval(insn->src1);
-		break;
-
-	case OP_SETVAL:
-		hash += hashval(insn->val);
-		break;
-
-	case OP_SYMADDR:
-		hash += hashval(insn->symbol);
-		break;
-
-	case OP_CAST:
-	case OP_SCAST:
-	case OP_PTRCAST:
-		/*
-		 * This is crap! Many "orig_types" are the
-		 * same as far as casts go, we should generate
-		 * some kind of "type hash" that is identical
-		 * for identical casts
-		 */
-		hash += hashval(insn->orig_type);
-		hash += hashval(insn->src);
-		break;
-
-	/* Other */
-	case OP_PHI: {
-		pseudo_t phi;
-		FOR_EACH_PTR(insn->phi_list, phi) {
-			struct instruction *def;
-			if (phi == VOID || !phi->def)
-				continue;
-			def = phi->def;
-			hash += hashval(def->src1);
-			hash += hashval(def->bb);
-		} END_FOR_EACH_PTR(phi);
-		break;
-	}
-
-	default:
-		/*
-		 * Nothing to do, don't even bother hashing them,
-		 * we're not going to try to CSE them
-		 */
-		return;
+	changed = simplify_instruction(insn);
+	if (changed) {
+		repeat_phase |= changed;
+		cse_queue_insn(insn);
+		if (insn->bb)
+			cse_queue_users(insn->target);
 	}
-	hash += hash >> 16;
-	hash &= INSN_HASH_SIZE-1;
-	add_instruction(insn_hash_table + hash, insn);
-}
-
-static void clean_up_insns(struct entrypoint *ep)
-{
-	struct basic_block *bb;
-
-	FOR_EACH_PTR(ep->bbs, bb) {
-		struct instruction *insn;
-		FOR_EACH_PTR(bb->insns, insn) {
-			clean_up_one_instruction(bb, insn);
-		} END_FOR_EACH_PTR(insn);
-	} END_FOR_EACH_PTR(bb);
 }
 
 /* Compare two (sorted) phi-lists */
@@ -165,88 +112,6 @@ static int phi_list_compare(struct pseudo_list *l1, struct pseudo_list *l2)
 	FINISH_PTR_LIST(phi1);
 }
 
-static int insn_compare(const void *_i1, const void *_i2)
-{
-	const struct instruction *i1 = _i1;
-	const struct instruction *i2 = _i2;
-
-	if (i1->opcode != i2->opcode)
-		return i1->opcode < i2->opcode ? -1 : 1;
-
-	switch (i1->opcode) {
-	case OP_SEL:
-		if (i1->src3 != i2->src3)
-			return i1->src3 < i2->src3 ? -1 : 1;
-		/* Fall-through to binops */
-
-	/* Binary arithmetic */
-	case OP_ADD: case OP_SUB:
-	case OP_MULU: case OP_MULS:
-	case OP_DIVU: case OP_DIVS:
-	case OP_MODU: case OP_MODS:
-	case OP_SHL:
-	case OP_LSR: case OP_ASR:
-	case OP_AND: case OP_OR:
-
-	/* Binary logical */
-	case OP_XOR: case OP_AND_BOOL:
-	case OP_OR_BOOL:
-
-	/* Binary comparison */
-	case OP_SET_EQ: case OP_SET_NE:
-	case OP_SET_LE: case OP_SET_GE:
-	case OP_SET_LT: case OP_SET_GT:
-	case OP_SET_B:  case OP_SET_A:
-	case OP_SET_BE: case OP_SET_AE:
-		if (i1->src2 != i2->src2)
-			return i1->src2 < i2->src2 ? -1 : 1;
-		/* Fall through to unops */
-
-	/* Unary */
-	case OP_NOT: case OP_NEG:
-		if (i1->src1 != i2->src1)
-			return i1->src1 < i2->src1 ? -1 : 1;
-		break;
-
-	case OP_SYMADDR:
-		if (i1->symbol != i2->symbol)
-			return i1->symbol < i2->symbol ? -1 : 1;
-		break;
-
-	case OP_SETVAL:
-		if (i1->val != i2->val)
-			return i1->val < i2->val ? -1 : 1;
-		break;
-
-	/* Other */
-	case OP_PHI:
-		return phi_list_compare(i1->phi_list, i2->phi_list);
-
-	case OP_CAST:
-	case OP_SCAST:
-	case OP_PTRCAST:
-		/*
-		 * This is crap! See the comments on hashing.
-		 */
-		if (i1->orig_type != i2->orig_type)
-			return i1->orig_type < i2->orig_type ? -1 : 1;
-		if (i1->src != i2->src)
-			return i1->src < i2->src ? -1 : 1;
-		break;
-
-	default:
-		warning(i1->pos, "bad instruction on hash chain");
-	}
-	if (i1->size != i2->size)
-		return i1->size < i2->size ? -1 : 1;
-	return 0;
-}
-
-static void sort_instruction_list(struct instruction_list **list)
-{
-	sort_list((struct ptr_list **)list , insn_compare);
-}
-
 static struct instruction * cse_one_instruction(struct instruction *insn, struct instruction *def)
 {
 	convert_instruction_target(insn, def->target);
@@ -260,6 +125,7 @@ static struct instruction * cse_one_instruction(struct instruction *insn, struct
 				if (pu->insn == insn)
 					DELETE_CURRENT_PTR(pu);
 			} END_FOR_EACH_PTR(pu);
+			cse_queue_insn(phi->def);
 		} END_FOR_EACH_PTR(phi);
 	}
 
@@ -269,28 +135,6 @@ static struct instruction * cse_one_instruction(struct instruction *insn, struct
 	return def;
 }
 
-/*
- * Does "bb1" dominate "bb2"?
- */
-static int bb_dominates(struct entrypoint *ep, struct basic_block *bb1, struct basic_block *bb2, unsigned long generation)
-{
-	struct basic_block *parent;
-
-	/* Nothing dominates the entrypoint.. */
-	if (bb2 == ep->entry->bb)
-		return 0;
-	FOR_EACH_PTR(bb2->parents, parent) {
-		if (parent == bb1)
-			continue;
-		if (parent->generation == generation)
-			continue;
-		parent->generation = generation;
-		if (!bb_dominates(ep, bb1, parent, generation))
-			return 0;
-	} END_FOR_EACH_PTR(parent);
-	return 1;
-}
-
 static struct basic_block *trivial_common_parent(struct basic_block *bb1, struct basic_block *bb2)
 {
 	struct basic_block *parent;
@@ -344,13 +188,20 @@ static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction
 		warning(b1->pos, "Whaa? unable to find CSE instructions");
 		return i1;
 	}
-	if (bb_dominates(ep, b1, b2, ++bb_generation))
+	if (bb_dominates(b1, b2))
 		return cse_one_instruction(i2, i1);
 
-	if (bb_dominates(ep, b2, b1, ++bb_generation))
+	if (bb_dominates(b2, b1))
 		return cse_one_instruction(i1, i2);
 
-	/* No direct dominance - but we could try to find a common ancestor.. */
+	/*
+	 * No direct dominance - but we could try to find a common ancestor..
+	 *
+	 * Only hoist into a single parent of both blocks: anything higher
+	 * up the dominator tree may also lead to paths that never reach
+	 * either block, and the instruction could trap there (a division
+	 * guarded by a test of its divisor, for example).
+	 */
 	common = trivial_common_parent(b1, b2);
 	if (common) {
 		i1 = cse_one_instruction(i2, i1);
@@ -361,40 +212,360 @@ static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction
 	return i1;
 }
 
-void cleanup_and_cse(struct entrypoint *ep)
+/*
+ * Global value numbering.
+ *
+ * A full pass walks the dominator tree in preorder, simplifying each
+ * instruction and then looking it up by value. Everything dominating
+ * an instruction has been dealt with by the time we get to it, so its
+ * operands are already the leaders of their values, and a whole chain
+ * of redundant computations folds away in the one walk.
+ *
+ * The keys are canonical: the operands of commutative operations are
+ * put in a fixed order, and a comparison and its mirror image (a < b,
+ * b > a) get the same key. Loads are keyed on their address and on a
+ * "memory version", which changes at every store, call or asm, and is
+ * only handed down the dominator tree to blocks that have nowhere else
+ * to come from than their dominator.
+ *
+ * Equal instructions are merged by try_to_cse(), which also knows how
+ * to hoist two of them that don't dominate each other into a parent
+ * they share. That's why the entries stay in the table when the walk
+ * leaves their subtree: a later sibling may still want them. An entry
+ * is checked against the instruction it came from when found, since
+ * that may have changed.
+ */
+struct gvn_key {
+	unsigned long hash;
+	unsigned int opcode, size;
+	unsigned long a, b, c;
+};
+
+struct gvn_entry {
+	struct gvn_key key;
+	struct instruction *insn;
+	int next;
+};
+
+#define GVN_MIN_SIZE 256
+
+static struct gvn_entry *gvn_entries;
+static int *gvn_buckets;
+static unsigned int gvn_nr, gvn_alloc, gvn_size;
+static unsigned long gvn_version;
+
+static int swap_compare(int opcode)
+{
+	switch (opcode) {
+	case OP_SET_LE: return OP_SET_GE;
+	case OP_SET_GE: return OP_SET_LE;
+	case OP_SET_LT: return OP_SET_GT;
+	case OP_SET_GT: return OP_SET_LT;
+	case OP_SET_B:  return OP_SET_A;
+	case OP_SET_A:  return OP_SET_B;
+	case OP_SET_BE: return OP_SET_AE;
+	case OP_SET_AE: return OP_SET_BE;
+	}
+	return opcode;
+}
+
+/*
+ * Fill in the key of "insn", and return 0 if it isn't something
+ * we number. "mem" is the memory version at the instruction, or
+ * zero if unknown, in which case loads aren't numbered either.
+ */
+static int gvn_key(struct instruction *insn, unsigned long mem, struct gvn_key *key)
+{
+	pseudo_t src1, src2;
+	unsigned long hash;
+
+	key->opcode = insn->opcode;
+	key->size = insn->size;
+	key->a = key->b = key->c = 0;
+
+	switch (insn->opcode) {
+	case OP_SEL:
+		key->c = hashval(insn->src3);
+		/* Fall through */
+
+	/* Binary arithmetic */
+	case OP_SUB:
+	case OP_DIVU: case OP_DIVS:
+	case OP_MODU: case OP_MODS:
+	case OP_SHL:
+	case OP_LSR: case OP_ASR:
+		key->a = hashval(insn->src1);
+		key->b = hashval(insn->src2);
+		break;
+
+	/* Commutative */
+	case OP_ADD: case OP_MULU: case OP_MULS:
+	case OP_AND: case OP_OR: case OP_XOR:
+	case OP_AND_BOOL: case OP_OR_BOOL:
+	case OP_SET_EQ: case OP_SET_NE:
+
+	/* Binary comparison, with a mirror image */
+	case OP_SET_LE: case OP_SET_GE:
+	case OP_SET_LT: case OP_SET_GT:
+	case OP_SET_B:  case OP_SET_A:
+	case OP_SET_BE: case OP_SET_AE:
+		src1 = insn->src1;
+		src2 = insn->src2;
+		if (src1 > src2) {
+			src1 = insn->src2;
+			src2 = insn->src1;
+			key->opcode = swap_compare(insn->opcode);
+		}
+		key->a = hashval(src1);
+		key->b = hashval(src2);
+		break;
+
+	/* Unary */
+	case OP_NOT: case OP_NEG:
+		key->a = hashval(insn->src1);
+		break;
+
+	case OP_SETVAL:
+		key->a = hashval(insn->val);
+		break;
+
+	case OP_SYMADDR:
+		key->a = hashval(insn->symbol);
+		break;
+
+	case OP_CAST:
+	case OP_SCAST:
+	case OP_PTRCAST:
+		/*
+		 * This is crap! Many "orig_types" are the
+		 * same as far as casts go, we should generate
+		 * some kind of "type hash" that is identical
+		 * for identical casts
+		 */
+		key->a = hashval(insn->src);
+		key->b = hashval(insn->orig_type);
+		break;
+
+	case OP_LOAD:
+		if (!mem)
+			return 0;
+		if (insn->is_volatile)
+			return 0;
+		key->a = hashval(insn->src);
+		key->b = insn->offset;
+		key->c = mem;
+		break;
+
+	/* Phi-nodes are compared on their sources, see gvn_equal() */
+	case OP_PHI: {
+		pseudo_t phi;
+		FOR_EACH_PTR(insn->phi_list, phi) {
+			struct instruction *def;
+			if (phi == VOID || !phi->def)
+				continue;
+			def = phi->def;
+			key->a += hashval(def->src1);
+			key->b += hashval(def->bb);
+		} END_FOR_EACH_PTR(phi);
+		break;
+	}
+
+	default:
+		return 0;
+	}
+
+	hash = (key->opcode << 3) + (key->size >> 3);
+	hash = (hash * 31 + key->a) * 31 + key->b;
+	hash = hash * 31 + key->c;
+	hash += hash >> 16;
+	key->hash = hash;
+	return 1;
+}
+
+static int same_key(const struct gvn_key *k1, const struct gvn_key *k2)
+{
+	return k1->hash == k2->hash && k1->opcode == k2->opcode &&
+	       k1->size == k2->size && k1->a == k2->a &&
+	       k1->b == k2->b && k1->c == k2->c;
+}
+
+static int gvn_equal(struct gvn_entry *entry, const struct gvn_key *key, struct instruction *insn)
+{
+	struct instruction *leader = entry->insn;
+	struct gvn_key now;
+
+	if (!same_key(&entry->key, key))
+		return 0;
+	/* Did the leader change since it was entered? */
+	if (!gvn_key(leader, entry->key.c, &now) || !same_key(&entry->key, &now))
+		return 0;
+	if (insn->opcode == OP_PHI)
+		return !phi_list_compare(leader->phi_list, insn->phi_list);
+	return 1;
+}
+
+static void gvn_rehash(unsigned int size)
+{
+	unsigned int i;
+
+	if (size != gvn_size) {
+		free(gvn_buckets);
+		gvn_buckets = malloc(size * sizeof(*gvn_buckets));
+		if (!gvn_buckets)
+			die("out of memory for value numbers");
+		gvn_size = size;
+	}
+	for (i = 0; i < size; i++)
+		gvn_buckets[i] = -1;
+	for (i = 0; i < gvn_nr; i++) {
+		struct gvn_entry *entry = gvn_entries + i;
+		int *bucket = gvn_buckets + (entry->key.hash & (size - 1));
+		entry->next = *bucket;
+		*bucket = i;
+	}
+}
+
+static void gvn_add(const struct gvn_key *key, struct instruction *insn)
 {
+	struct gvn_entry *entry;
+	int *bucket;
+
+	if (gvn_nr == gvn_alloc) {
+		gvn_alloc = gvn_alloc ? gvn_alloc * 2 : GVN_MIN_SIZE;
+		gvn_entries = realloc(gvn_entries, gvn_alloc * sizeof(*gvn_entries));
+		if (!gvn_entries)
+			die("out of memory for value numbers");
+	}
+	entry = gvn_entries + gvn_nr;
+	entry->key = *key;
+	entry->insn = insn;
+	gvn_nr++;
+	if (gvn_nr > gvn_size) {
+		gvn_rehash(gvn_size * 2);
+		return;
+	}
+	bucket = gvn_buckets + (key->hash & (gvn_size - 1));
+	entry->next = *bucket;
+	*bucket = entry - gvn_entries;
+}
+
+static void gvn_clear(void)
+{
+	gvn_nr = 0;
+	gvn_rehash(GVN_MIN_SIZE);
+}
+
+static void gvn_insn(struct entrypoint *ep, struct instruction *insn, unsigned long mem)
+{
+	struct gvn_key key;
 	int i;
 
+	if (!insn->bb || !gvn_key(insn, mem, &key))
+		return;
+
+	for (i = gvn_buckets[key.hash & (gvn_size - 1)]; i >= 0; i = gvn_entries[i].next) {
+		struct gvn_entry *entry = gvn_entries + i;
+		struct instruction *leader = entry->insn;
+
+		if (leader == insn || !leader->bb)
+			continue;
+		if (!gvn_equal(entry, &key, insn))
+			continue;
+		/* Never make a load happen on a path it wasn't on */
+		if (insn->opcode == OP_LOAD && !bb_dominates(leader->bb, insn->bb))
+			continue;
+		entry->insn = try_to_cse(ep, leader, insn);
+		if (!insn->bb || !leader->bb)
+			return;
+	}
+	gvn_add(&key, insn);
+}
+
+static void gvn_block(struct entrypoint *ep, struct basic_block *bb, unsigned long mem)
+{
+	struct basic_block *child;
+	struct instruction *insn;
+
+	if (bb_list_size(bb->parents) != 1 || first_basic_block(bb->parents) != bb->idom)
+		mem = ++gvn_version;
+
+	FOR_EACH_PTR(bb->insns, insn) {
+		clean_up_one_instruction(bb, insn);
+		gvn_insn(ep, insn, mem);
+
+		switch (insn->opcode) {
+		case OP_STORE: case OP_CALL: case OP_ASM:
+			mem = ++gvn_version;
+			break;
+		}
+	} END_FOR_EACH_PTR(insn);
+
+	FOR_EACH_PTR(bb->dom_children, child) {
+		gvn_block(ep, child, mem);
+	} END_FOR_EACH_PTR(child);
+}
+
+static void clean_up_insns(struct entrypoint *ep)
+{
+	struct basic_block *bb;
+
+	gvn_clear();
+	build_dominator_tree(ep);
+	gvn_block(ep, ep->entry->bb, 0);
+
+	/* What isn't reachable still wants to be cleaned up */
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *insn;
+
+		if (bb->dom_pre)
+			continue;
+		FOR_EACH_PTR(bb->insns, insn) {
+			clean_up_one_instruction(bb, insn);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+}
+
+static void clean_up_worklist(struct entrypoint *ep)
+{
+	struct instruction_vec tmp = cse_todo;
+	struct instruction *insn;
+
+	cse_todo = cse_worklist;
+	cse_worklist = tmp;
+	FOR_EACH_VEC(&cse_todo, insn) {
+		insn->queued = 0;
+		if (!insn->bb)
+			continue;
+		/* insert_branch() unlinks the old branch but leaves it its bb */
+		if (insn->opcode >= OP_TERMINATOR && insn->opcode <= OP_TERMINATOR_END &&
+		    last_instruction(insn->bb->insns) != insn)
+			continue;
+		ep->cse_requeued++;
+		clean_up_one_instruction(insn->bb, insn);
+		gvn_insn(ep, insn, 0);
+	} END_FOR_EACH_VEC(insn);
+	reset_ptr_vec(&cse_todo);
+}
+
+void cleanup_and_cse(struct entrypoint *ep)
+{
 	simplify_memops(ep);
-repeat:
+	cse_tracking = 1;
+
 	repeat_phase = 0;
+	ep->cse_rounds++;
+	ep->cse_sweeps++;
 	clean_up_insns(ep);
-	for (i = 0; i < INSN_HASH_SIZE; i++) {
-		struct instruction_list **list = insn_hash_table + i;
-		if (*list) {
-			if (instruction_list_size(*list) > 1) {
-				struct instruction *insn, *last;
-
-				sort_instruction_list(list);
-
-				last = NULL;
-				FOR_EACH_PTR(*list, insn) {
-					if (!insn->bb)
-						continue;
-					if (last) {
-						if (!insn_compare(last, insn))
-							insn = try_to_cse(ep, last, insn);
-					}
-					last = insn;
-				} END_FOR_EACH_PTR(insn);
-			}
-			free_ptr_list((struct ptr_list **)list);
-		}
-	}
-
-	if (repeat_phase & REPEAT_SYMBOL_CLEANUP)
-		simplify_memops(ep);
 
-	if (repeat_phase & REPEAT_CSE)
-		goto repeat;
+	for (;;) {
+		if (repeat_phase & REPEAT_SYMBOL_CLEANUP)
+			simplify_memops(ep);
+		if (!ptr_vec_size(&cse_worklist))
+			break;
+		repeat_phase = 0;
+		ep->cse_rounds++;
+		clean_up_worklist(ep);
+	}
+	cse_tracking = 0;
+	gvn_clear();
 }
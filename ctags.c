@@ -28,33 +28,46 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
+#include "allocate.h"
 #include "parse.h"
 #include "scope.h"
+#include "checksum.h"
 
 static struct symbol_list *taglist = NULL;
 
 static void examine_symbol(struct symbol *sym);
 
-#define MAX(_x,_y) ((_x) > (_y) ? (_x) : (_y))
+#define MIN(_x,_y) ((_x) < (_y) ? (_x) : (_y))
 
-static int cmp_sym(const void *m, const void *n)
+/*
+ * Tags are sorted by name, then file, then line from the bottom up.
+ * The tags kept by -fincremental are merged back in the same order,
+ * so it has to be a total one.
+ */
+static int cmp_tag(const char *a_name, int a_len, const char *a_file, int a_line,
+		   const char *b_name, int b_len, const char *b_file, int b_line)
 {
-	const struct ident *a = ((const struct symbol *)m)->ident;
-	const struct ident *b = ((const struct symbol *)n)->ident;
-	int ret = strncmp(a->name, b->name, MAX(a->len, b->len));
-	if (!ret) {
-		const struct position a_pos = ((const struct symbol *)m)->pos;
-		const struct position b_pos = ((const struct symbol *)n)->pos;
+	int ret = memcmp(a_name, b_name, MIN(a_len, b_len));
 
-		ret = strcmp(stream_name(a_pos.stream),
-		             stream_name(b_pos.stream));
-		if (!ret)
-			return a_pos.line < b_pos.line;
-	}
+	if (!ret)
+		ret = a_len - b_len;
+	if (!ret)
+		ret = strcmp(a_file, b_file);
+	if (!ret)
+		ret = b_line - a_line;
 	return ret;
 }
 
+static int cmp_sym(const void *m, const void *n)
+{
+	const struct symbol *a = m, *b = n;
+
+	return cmp_tag(a->ident->name, a->ident->len, stream_name(a->pos.stream), a->pos.line,
+		       b->ident->name, b->ident->len, stream_name(b->pos.stream), b->pos.line);
+}
+
 static void show_tag_header(FILE *fp)
 {
 	fprintf(fp, "!_TAG_FILE_FORMAT\t2\t/extended format; --format=1 will not append ;\" to lines/\n");
@@ -71,15 +84,323 @@ static inline void show_symbol_tag(FILE *fp, struct symbol *sym)
 	       stream_name(sym->pos.stream), sym->pos.line, (int)sym->kind);
 }
 
+/*
+ * With -fincremental the old tags file is read back first. For each
+ * file that was read it remembers its mtime, size and crc, and for
+ * each file given on the command line the files it read. A file whose
+ * files are all unchanged isn't parsed again, and the tags of the
+ * files that weren't read this time are kept from the old tags file.
+ */
+struct tag_stamp {
+	char *path;
+	long long mtime, size;
+	unsigned long crc;
+};
+
+struct tag_use {
+	char *unit, *path;
+	int fresh;
+};
+
+struct old_tag {
+	char *text, *name, *file;
+	int line;
+};
+
+static struct tag_stamp *stamps;
+static struct tag_use *uses;
+static struct old_tag *old_tags;
+static char **parsed, **fresh;
+static int nr_stamps, nr_uses, nr_old_tags, nr_parsed, nr_fresh;
+
+static int cmp_string(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int cmp_stamp(const void *a, const void *b)
+{
+	return strcmp(((const struct tag_stamp *)a)->path, ((const struct tag_stamp *)b)->path);
+}
+
+static int cmp_use(const void *m, const void *n)
+{
+	const struct tag_use *a = m, *b = n;
+	int ret = strcmp(a->unit, b->unit);
+
+	return ret ? ret : strcmp(a->path, b->path);
+}
+
+static int cmp_old_tag(const void *m, const void *n)
+{
+	const struct old_tag *a = m, *b = n;
+
+	return cmp_tag(a->name, strlen(a->name), a->file, a->line,
+		       b->name, strlen(b->name), b->file, b->line);
+}
+
+static int file_stamp(const char *path, struct tag_stamp *stamp, int crc)
+{
+	struct stat st;
+	FILE *f;
+	int c;
+
+	if (stat(path, &st) || !S_ISREG(st.st_mode))
+		return 0;
+	stamp->mtime = st.st_mtime;
+	stamp->size = st.st_size;
+	stamp->crc = 0;
+	if (!crc)
+		return 1;
+
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+	stamp->crc = 0xffffffff;
+	while ((c = getc(f)) != EOF)
+		stamp->crc = partial_crc32_one(c, stamp->crc);
+	stamp->crc ^= 0xffffffff;
+	fclose(f);
+	return 1;
+}
+
+static int file_changed(char *path)
+{
+	struct tag_stamp key = { .path = path }, now;
+	struct tag_stamp *old = bsearch(&key, stamps, nr_stamps, sizeof(*stamps), cmp_stamp);
+
+	if (!old || !file_stamp(path, &now, 0))
+		return 1;
+	if (now.mtime == old->mtime && now.size == old->size)
+		return 0;
+	if (now.size != old->size || !file_stamp(path, &now, 1) || now.crc != old->crc)
+		return 1;
+	/* Only touched: don't read it again next time */
+	old->mtime = now.mtime;
+	return 0;
+}
+
+static int unit_unchanged(char *unit)
+{
+	int lo = 0, hi = nr_uses, i, found = 0;
+
+	/* The first use of the unit, they are sorted */
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (strcmp(uses[mid].unit, unit) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (i = lo; i < nr_uses && !strcmp(uses[i].unit, unit); i++) {
+		if (file_changed(uses[i].path))
+			return 0;
+		found = 1;
+	}
+	return found;
+}
+
+static char *tag_field(char **line)
+{
+	char *field = *line, *end = strchr(field, '\t');
+
+	if (!end)
+		return NULL;
+	*end = '\0';
+	*line = end + 1;
+	return field;
+}
+
+/* The comment of a pseudo-tag, between slashes */
+static char *tag_comment(char *field)
+{
+	size_t len = strlen(field);
+
+	if (len < 2 || field[0] != '/' || field[len-1] != '/')
+		return NULL;
+	field[len-1] = '\0';
+	return field + 1;
+}
+
+static void read_old_tag(char *text)
+{
+	char *line = strdup(text), *rest = line;
+	char *name = tag_field(&rest), *file = tag_field(&rest);
+	char *value;
+	struct tag_stamp *stamp;
+	struct tag_use *use;
+	struct old_tag *tag;
+
+	if (!name || !file)
+		goto skip;
+
+	if (!strcmp(name, "!_TAG_SPARSE_STAMP")) {
+		value = tag_comment(rest);
+		stamps = grow_array(stamps, nr_stamps, sizeof(*stamps));
+		stamp = stamps + nr_stamps;
+		if (!value || sscanf(value, "%lld %lld %lu", &stamp->mtime, &stamp->size, &stamp->crc) != 3)
+			goto skip;
+		stamp->path = strdup(file);
+		nr_stamps++;
+	} else if (!strcmp(name, "!_TAG_SPARSE_USES")) {
+		value = tag_comment(rest);
+		if (!value)
+			goto skip;
+		uses = grow_array(uses, nr_uses, sizeof(*uses));
+		use = uses + nr_uses++;
+		use->unit = strdup(file);
+		use->path = strdup(value);
+		use->fresh = 0;
+	} else if (strncmp(name, "!_TAG_", 6)) {
+		old_tags = grow_array(old_tags, nr_old_tags, sizeof(*old_tags));
+		tag = old_tags + nr_old_tags++;
+		tag->text = text;
+		tag->name = strdup(name);
+		tag->file = strdup(file);
+		tag->line = atoi(rest);
+		free(line);
+		return;
+	}
+skip:
+	free(line);
+	free(text);
+}
+
+static void read_tags(const char *name)
+{
+	FILE *fp = fopen(name, "r");
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+
+	if (!fp)
+		return;
+	while ((len = getline(&line, &size, fp)) > 0) {
+		if (line[len-1] == '\n')
+			line[len-1] = '\0';
+		read_old_tag(strdup(line));
+	}
+	free(line);
+	fclose(fp);
+
+	qsort(stamps, nr_stamps, sizeof(*stamps), cmp_stamp);
+	qsort(uses, nr_uses, sizeof(*uses), cmp_use);
+}
+
+/* Remember what a file read, its tags are all new */
+static void note_unit(char *unit, int first_stream)
+{
+	int i;
+
+	parsed = grow_array(parsed, nr_parsed, sizeof(*parsed));
+	parsed[nr_parsed++] = unit;
+
+	for (i = first_stream; i < input_stream_nr; i++) {
+		uses = grow_array(uses, nr_uses, sizeof(*uses));
+		uses[nr_uses].unit = unit;
+		uses[nr_uses].path = (char *)stream_name(i);
+		uses[nr_uses].fresh = 1;
+		nr_uses++;
+	}
+}
+
+static int has_stamp(char *path)
+{
+	struct tag_stamp key = { .path = path };
+
+	return bsearch(&key, stamps, nr_stamps, sizeof(*stamps), cmp_stamp) != NULL;
+}
+
+static int is_fresh(char *path)
+{
+	return bsearch(&path, fresh, nr_fresh, sizeof(*fresh), cmp_string) != NULL;
+}
+
+static int is_parsed(char *unit)
+{
+	return bsearch(&unit, parsed, nr_parsed, sizeof(*parsed), cmp_string) != NULL;
+}
+
+/*
+ * Everything read in this run is fresh: its old tags and stamps are
+ * replaced, and so are the uses of the files parsed again.
+ */
+static void update_stamps(void)
+{
+	struct tag_stamp stamp;
+	int i, nr;
+
+	for (i = 0; i < input_stream_nr; i++) {
+		fresh = grow_array(fresh, nr_fresh, sizeof(*fresh));
+		fresh[nr_fresh++] = (char *)stream_name(i);
+	}
+	qsort(fresh, nr_fresh, sizeof(*fresh), cmp_string);
+	qsort(parsed, nr_parsed, sizeof(*parsed), cmp_string);
+
+	for (i = nr = 0; i < nr_stamps; i++) {
+		if (!is_fresh(stamps[i].path))
+			stamps[nr++] = stamps[i];
+	}
+	nr_stamps = nr;
+	for (i = 0; i < nr_fresh; i++) {
+		if (i && !strcmp(fresh[i], fresh[i-1]))
+			continue;
+		if (!file_stamp(fresh[i], &stamp, 1))
+			continue;
+		stamp.path = fresh[i];
+		stamps = grow_array(stamps, nr_stamps, sizeof(*stamps));
+		stamps[nr_stamps++] = stamp;
+	}
+	qsort(stamps, nr_stamps, sizeof(*stamps), cmp_stamp);
+
+	/* The uses of a parsed file all come from this run */
+	for (i = nr = 0; i < nr_uses; i++) {
+		struct tag_use *use = uses + i;
+
+		if (!use->fresh && is_parsed(use->unit))
+			continue;
+		uses[nr++] = *use;
+	}
+	nr_uses = nr;
+	qsort(uses, nr_uses, sizeof(*uses), cmp_use);
+
+	for (i = nr = 0; i < nr_old_tags; i++) {
+		if (!is_fresh(old_tags[i].file))
+			old_tags[nr++] = old_tags[i];
+	}
+	nr_old_tags = nr;
+	qsort(old_tags, nr_old_tags, sizeof(*old_tags), cmp_old_tag);
+}
+
+static void show_stamps(FILE *fp)
+{
+	int i;
+
+	for (i = 0; i < nr_stamps; i++) {
+		struct tag_stamp *stamp = stamps + i;
+		fprintf(fp, "!_TAG_SPARSE_STAMP\t%s\t/%lld %lld %lu/\n",
+			stamp->path, stamp->mtime, stamp->size, stamp->crc);
+	}
+	for (i = 0; i < nr_uses; i++) {
+		struct tag_use *use = uses + i;
+		if (i && !cmp_use(use, use - 1))
+			continue;
+		if (!has_stamp(use->path))
+			continue;
+		fprintf(fp, "!_TAG_SPARSE_USES\t%s\t/%s/\n", use->unit, use->path);
+	}
+}
+
 static void show_tags(struct symbol_list *list)
 {
 	struct symbol *sym;
 	struct ident *ident = NULL;
 	struct position pos = {};
 	static const char *filename;
+	int old = 0;
 	FILE *fp;
 
-	if (!list)
+	if (!list && !nr_old_tags)
 		return;
 
 	fp = fopen("tags", "w");
@@ -88,16 +409,27 @@ static void show_tags(struct symbol_list *list)
 		return;
 	}
 	show_tag_header(fp);
+	show_stamps(fp);
 	FOR_EACH_PTR(list, sym) {
 		if (ident == sym->ident && pos.line == sym->pos.line &&
 		    !strcmp(filename, stream_name(sym->pos.stream)))
 			continue;
 
+		for (; old < nr_old_tags; old++) {
+			struct old_tag *tag = old_tags + old;
+			if (cmp_tag(tag->name, strlen(tag->name), tag->file, tag->line,
+				    sym->ident->name, sym->ident->len,
+				    stream_name(sym->pos.stream), sym->pos.line) > 0)
+				break;
+			fprintf(fp, "%s\n", tag->text);
+		}
 		show_symbol_tag(fp, sym);
 		ident = sym->ident;
 		pos = sym->pos;
 		filename = stream_name(sym->pos.stream);
 	} END_FOR_EACH_PTR(sym);
+	for (; old < nr_old_tags; old++)
+		fprintf(fp, "%s\n", old_tags[old].text);
 	fclose(fp);
 }
 
@@ -216,12 +548,20 @@ int main(int argc, char **argv)
 	char *file;
 
 	examine_symbol_list(sparse_initialize(argc, argv, &filelist));
+	if (fincremental)
+		read_tags("tags");
 	FOR_EACH_PTR_NOTAG(filelist, file) {
+		int first_stream = input_stream_nr;
+
+		if (fincremental && unit_unchanged(file))
+			continue;
 		sparse(file);
 		examine_symbol_list(file_scope->symbols);
+		note_unit(file, first_stream);
 	} END_FOR_EACH_PTR_NOTAG(file);
 	examine_symbol_list(global_scope->symbols);
 	sort_list((struct ptr_list **)&taglist, cmp_sym);
+	update_stamps();
 	show_tags(taglist);
 	return 0;
 }
@@ -220,7 +220,7 @@ static void examine_sym_node(struct symbol *node, struct ident *root)
 			break;
 
 		case SYM_ARRAY:
-			do_expression(U_R_VAL, base->array_size);
+			do_expression(U_R_VAL, cold_field(base, array_size));
 		case SYM_PTR: case SYM_FN:
 			node = base;
 			break;
@@ -575,7 +575,7 @@ static inline struct symbol *do_symbol(struct symbol *sym)
 		do_sym_list(type->arguments);
 		return_type = base_type(type);
 		do_statement(U_VOID, sym->ctype.modifiers & MOD_INLINE
-					? type->inline_stmt
+					? cold_field(type, inline_stmt)
 					: type->stmt);
 	}
 
@@ -87,7 +87,7 @@ static struct symbol *evaluate_string(struct expression *expr)
 	struct expression *initstr = alloc_expression(expr->pos, EXPR_STRING);
 	unsigned int length = expr->string->length;
 
-	sym->array_size = alloc_const_expression(expr->pos, length);
+	symbol_cold(sym)->array_size = alloc_const_expression(expr->pos, length);
 	sym->bit_size = bytes_to_bits(length);
 	sym->ctype.alignment = 1;
 	sym->string = 1;
@@ -98,7 +98,7 @@ static struct symbol *evaluate_string(struct expression *expr)
 	initstr->ctype = sym;
 	initstr->string = expr->string;
 
-	array->array_size = sym->array_size;
+	symbol_cold(array)->array_size = sym->cold->array_size;
 	array->bit_size = bytes_to_bits(length);
 	array->ctype.alignment = 1;
 	array->ctype.modifiers = MOD_STATIC;
@@ -1610,7 +1610,8 @@ static struct symbol *degenerate(struct expression *expr)
 
 			a->ctype.base_type = expr->base->ctype;
 			a->bit_size = expr->base->ctype->bit_size;
-			a->array_size = expr->base->ctype->array_size;
+			if (cold_field(expr->base->ctype, array_size))
+				symbol_cold(a)->array_size = expr->base->ctype->cold->array_size;
 
 			e0 = alloc_expression(expr->pos, EXPR_SYMBOL);
 			e0->symbol = a;
@@ -1739,7 +1740,8 @@ static struct symbol *evaluate_dereference(struct expression *expr)
 	}
 
 	node->bit_size = target->bit_size;
-	node->array_size = target->array_size;
+	if (cold_field(target, array_size))
+		symbol_cold(node)->array_size = target->cold->array_size;
 
 	expr->ctype = node;
 	return node;
@@ -2829,8 +2831,8 @@ static int evaluate_symbol_call(struct expression *expr)
 		int ret;
 		struct symbol *curr = current_fn;
 
-		if (ctype->definition)
-			ctype = ctype->definition;
+		if (cold_field(ctype, definition))
+			ctype = ctype->cold->definition;
 
 		current_fn = ctype->ctype.base_type;
 
@@ -3145,13 +3147,13 @@ static struct symbol *evaluate_symbol(struct symbol *sym)
 	if (base_type->type == SYM_FN) {
 		struct symbol *curr = current_fn;
 
-		if (sym->definition && sym->definition != sym)
-			return evaluate_symbol(sym->definition);
+		if (cold_field(sym, definition) && sym->cold->definition != sym)
+			return evaluate_symbol(sym->cold->definition);
 
 		current_fn = base_type;
 
 		examine_fn_arguments(base_type);
-		if (!base_type->stmt && base_type->inline_stmt)
+		if (!base_type->stmt && cold_field(base_type, inline_stmt))
 			uninline(sym);
 		if (base_type->stmt)
 			evaluate_statement(base_type->stmt);
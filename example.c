@@ -137,6 +137,7 @@ static struct hardreg hardregs[] = {
 
 struct bb_state {
 	struct position pos;
+	struct basic_block *bb;
 	struct storage_hash_list *inputs;
 	struct storage_hash_list *outputs;
 	struct storage_hash_list *internal;
@@ -222,6 +223,16 @@ static struct storage_hash *find_storage_hash(pseudo_t pseudo, struct storage_ha
 	return NULL;
 }
 
+static struct storage_hash *find_input_hash(struct bb_state *state, pseudo_t pseudo)
+{
+	return lookup_storage_hash(state->bb, pseudo, STOR_IN);
+}
+
+static struct storage_hash *find_output_hash(struct bb_state *state, pseudo_t pseudo)
+{
+	return lookup_storage_hash(state->bb, pseudo, STOR_OUT);
+}
+
 static struct storage_hash *find_or_create_hash(pseudo_t pseudo, struct storage_hash_list **listp)
 {
 	struct storage_hash *entry;
@@ -337,7 +348,7 @@ static int can_regenerate(struct bb_state *state, pseudo_t pseudo)
 		return 1;
 
 	default:
-		in = find_storage_hash(pseudo, state->inputs);
+		in = find_input_hash(state, pseudo);
 		if (in && in->storage->type != REG_REG)
 			return 1;
 		in = find_storage_hash(pseudo, state->internal);
@@ -358,7 +369,7 @@ static void flush_one_pseudo(struct bb_state *state, struct hardreg *hardreg, ps
 	output_comment(state, "flushing %s from %s", show_pseudo(pseudo), hardreg->name);
 	out = find_storage_hash(pseudo, state->internal);
 	if (!out) {
-		out = find_storage_hash(pseudo, state->outputs);
+		out = find_output_hash(state, pseudo);
 		if (!out)
 			out = find_or_create_hash(pseudo, &state->internal);
 	}
@@ -409,9 +420,9 @@ static struct storage_hash *find_pseudo_storage(struct bb_state *state, pseudo_t
 
 	src = find_storage_hash(pseudo, state->internal);
 	if (!src) {
-		src = find_storage_hash(pseudo, state->inputs);
+		src = find_input_hash(state, pseudo);
 		if (!src) {
-			src = find_storage_hash(pseudo, state->outputs);
+			src = find_output_hash(state, pseudo);
 			/* Undefined? Screw it! */
 			if (!src)
 				return NULL;
@@ -467,7 +478,7 @@ static struct hardreg *preferred_reg(struct bb_state *state, pseudo_t target)
 {
 	struct storage_hash *dst;
 
-	dst = find_storage_hash(target, state->outputs);
+	dst = find_output_hash(state, target);
 	if (dst) {
 		struct storage *storage = dst->storage;
 		if (storage->type == REG_REG)
@@ -1553,7 +1564,7 @@ static void fill_output(struct bb_state *state, pseudo_t pseudo, struct storage
 	/* Do we have it in another storage? */
 	in = find_storage_hash(pseudo, state->internal);
 	if (!in) {
-		in = find_storage_hash(pseudo, state->inputs);
+		in = find_input_hash(state, pseudo);
 		/* Undefined? */
 		if (!in)
 			return;
@@ -1586,7 +1597,7 @@ static int final_pseudo_flush(struct bb_state *state, pseudo_t pseudo, struct ha
 	 * Since this pseudo is live at exit, we'd better have output 
 	 * storage for it..
 	 */
-	hash = find_storage_hash(pseudo, state->outputs);
+	hash = find_output_hash(state, pseudo);
 	if (!hash)
 		return 1;
 	out = hash->storage;
@@ -1769,6 +1780,7 @@ static void output_bb(struct basic_block *bb, unsigned long generation)
 	generate_list(bb->parents, generation);
 
 	state.pos = bb->pos;
+	state.bb = bb;
 	state.inputs = gather_storage(bb, STOR_IN);
 	state.outputs = gather_storage(bb, STOR_OUT);
 	state.internal = NULL;
@@ -1903,6 +1915,466 @@ static void arch_set_up_storage(struct entrypoint *ep)
 	} END_FOR_EACH_PTR(bb);
 }
 
+/*
+ * Linear-scan allocation of the inter-bb storage.
+ *
+ * Left alone, the storage that carries a pseudo from one bb to the
+ * next gets its register from whichever bb happens to be generated
+ * first, and ends up on the stack as soon as that register is busy.
+ * Instead, number the instructions in the order of ep->bbs, and give
+ * every storage the ranges where one of the pseudos it carries is
+ * live: the bbs that need it come from track_pseudo_liveness(), via
+ * set_up_storage(), which also gives it an output in every bb it
+ * flows through. The registers are then handed out with a linear
+ * scan over these intervals, in the order they start; an interval
+ * can have a register that another one uses in its holes.
+ *
+ * The storage already fixed by the arch rules keeps its register.
+ * When no register is free, whatever has the lowest spill cost (its
+ * uses and transfers, per position it covers) goes to the stack.
+ * Intervals across a call prefer the registers it doesn't clobber.
+ */
+struct bb_range {
+	int start, end;
+};
+
+struct live_range {
+	int start, end;
+};
+
+struct live_interval {
+	struct storage **storages;
+	int nr_storages;
+	struct live_range *ranges;
+	int nr_ranges;
+	int start, cost, first;
+	int regno;
+	unsigned fixed:1,
+		 calls:1;
+};
+
+#define CALL_CLOBBERED	((1 << 0) | (1 << 1) | (1 << 2))
+
+static int *call_positions;
+static int nr_call_positions;
+
+/* The position of each instruction, sorted by instruction for bsearch() */
+struct insn_pos {
+	struct instruction *insn;
+	int pos;
+};
+
+static struct insn_pos *insn_positions;
+static int nr_insn_positions;
+
+static int insn_pos_cmp(const void *_a, const void *_b)
+{
+	const struct insn_pos *a = _a, *b = _b;
+
+	if (a->insn != b->insn)
+		return a->insn < b->insn ? -1 : 1;
+	return 0;
+}
+
+static void number_bbs(struct entrypoint *ep, struct bb_range *ranges)
+{
+	struct basic_block *bb;
+	int pos = 0;
+
+	nr_call_positions = 0;
+	nr_insn_positions = 0;
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct bb_range *range = ranges++;
+		struct instruction *insn;
+
+		bb->priv = range;
+		range->start = pos++;
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (!insn->bb)
+				continue;
+			if (insn->opcode == OP_CALL) {
+				call_positions = grow_array(call_positions,
+					nr_call_positions, sizeof(*call_positions));
+				call_positions[nr_call_positions++] = pos;
+			}
+			insn_positions = grow_array(insn_positions,
+				nr_insn_positions, sizeof(*insn_positions));
+			insn_positions[nr_insn_positions].insn = insn;
+			insn_positions[nr_insn_positions].pos = pos;
+			nr_insn_positions++;
+			pos++;
+		} END_FOR_EACH_PTR(insn);
+		range->end = pos++;
+	} END_FOR_EACH_PTR(bb);
+	qsort(insn_positions, nr_insn_positions, sizeof(*insn_positions), insn_pos_cmp);
+}
+
+static int insn_position(struct instruction *insn)
+{
+	struct insn_pos key = { insn, 0 }, *found;
+
+	found = bsearch(&key, insn_positions, nr_insn_positions,
+			sizeof(*insn_positions), insn_pos_cmp);
+	if (!found) {
+		struct bb_range *range = insn->bb->priv;
+		return range->end;
+	}
+	return found->pos;
+}
+
+/* Is there a call strictly inside one of the ranges? */
+static int crosses_call(struct live_interval *li)
+{
+	int i;
+
+	for (i = 0; i < li->nr_ranges; i++) {
+		struct live_range *r = li->ranges + i;
+		int lo = 0, hi = nr_call_positions;
+
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (call_positions[mid] <= r->start)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo < nr_call_positions && call_positions[lo] < r->end)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Where in "bb" is the pseudo of this storage live? An incoming one
+ * until its last use, an outgoing one from its definition on, and
+ * all of the bb if we can't tell.
+ */
+static void add_to_interval(struct live_interval *li, struct storage_hash *hash)
+{
+	struct basic_block *bb = hash->bb;
+	struct bb_range *range = bb->priv;
+	pseudo_t pseudo = hash->pseudo;
+	int start = range->start, end = range->end;
+	struct pseudo_user *pu;
+	int uses = 0;
+
+	if (!has_use_list(pseudo) || pseudo->type == PSEUDO_SYM)
+		goto done;
+	if (hash->inout == STOR_IN) {
+		if (!lookup_storage_hash(bb, pseudo, STOR_OUT)) {
+			int last = -1;
+			FOR_EACH_PTR(pseudo->users, pu) {
+				if (pu->insn->bb == bb) {
+					int pos = insn_position(pu->insn);
+					if (pos > last)
+						last = pos;
+				}
+			} END_FOR_EACH_PTR(pu);
+			if (last >= 0)
+				end = last;
+		}
+	} else if (pseudo->def && pseudo->def->bb == bb) {
+		start = insn_position(pseudo->def);
+	}
+
+	FOR_EACH_PTR(pseudo->users, pu) {
+		if (pu->insn->bb == bb)
+			uses++;
+	} END_FOR_EACH_PTR(pu);
+
+done:
+	li->ranges = grow_array(li->ranges, li->nr_ranges, sizeof(*li->ranges));
+	li->ranges[li->nr_ranges].start = start;
+	li->ranges[li->nr_ranges].end = end;
+	li->nr_ranges++;
+	li->cost += 1 + uses;
+}
+
+static int live_range_cmp(const void *_a, const void *_b)
+{
+	const struct live_range *a = _a, *b = _b;
+
+	if (a->start != b->start)
+		return a->start - b->start;
+	return a->end - b->end;
+}
+
+/* Sort the ranges and merge the ones that touch */
+static void finish_interval(struct live_interval *li)
+{
+	struct live_range *r = li->ranges;
+	int i, nr = 0;
+
+	qsort(r, li->nr_ranges, sizeof(*r), live_range_cmp);
+	for (i = 0; i < li->nr_ranges; i++) {
+		if (nr && r[i].start <= r[nr - 1].end + 1) {
+			if (r[i].end > r[nr - 1].end)
+				r[nr - 1].end = r[i].end;
+			continue;
+		}
+		r[nr++] = r[i];
+	}
+	li->nr_ranges = nr;
+	li->start = r[0].start;
+}
+
+static int overlaps(struct live_interval *a, struct live_interval *b)
+{
+	int i = 0, j = 0;
+
+	while (i < a->nr_ranges && j < b->nr_ranges) {
+		struct live_range *ra = a->ranges + i, *rb = b->ranges + j;
+
+		if (ra->end < rb->start)
+			i++;
+		else if (rb->end < ra->start)
+			j++;
+		else
+			return 1;
+	}
+	return 0;
+}
+
+/* Spill cost per position, the lowest goes to the stack */
+static long spill_weight(struct live_interval *li)
+{
+	long size = 0;
+	int i;
+
+	for (i = 0; i < li->nr_ranges; i++)
+		size += li->ranges[i].end - li->ranges[i].start + 1;
+	return (long)li->cost * 1024 / size;
+}
+
+struct interval_hash {
+	struct storage_hash *hash;
+	void *key;
+	int nr;
+};
+
+static int interval_key_cmp(const void *_a, const void *_b)
+{
+	const struct interval_hash *a = _a, *b = _b;
+
+	if (a->key != b->key)
+		return a->key < b->key ? -1 : 1;
+	return a->nr - b->nr;
+}
+
+/*
+ * Where a storage only ever carries the same pseudo, it has the same
+ * value as all the others that do: give them one interval, so that
+ * the pseudo doesn't move around between the bbs.
+ */
+static void set_interval_keys(struct interval_hash *hashes, int nr)
+{
+	int i, j;
+
+	for (i = 0; i < nr; i++)
+		hashes[i].key = hashes[i].hash->storage;
+	qsort(hashes, nr, sizeof(*hashes), interval_key_cmp);
+	for (i = 0; i < nr; i = j) {
+		struct storage *storage = hashes[i].hash->storage;
+		pseudo_t pseudo = hashes[i].hash->pseudo;
+
+		for (j = i + 1; j < nr && hashes[j].key == storage; j++) {
+			if (hashes[j].hash->pseudo != pseudo)
+				pseudo = NULL;
+		}
+		if (!pseudo || storage->type != REG_UDEF)
+			continue;
+		while (i < j)
+			hashes[i++].key = pseudo;
+	}
+	qsort(hashes, nr, sizeof(*hashes), interval_key_cmp);
+}
+
+static void add_interval_storage(struct live_interval *li, struct storage *storage)
+{
+	int i;
+
+	for (i = 0; i < li->nr_storages; i++) {
+		if (li->storages[i] == storage)
+			return;
+	}
+	li->storages = grow_array(li->storages, li->nr_storages, sizeof(*li->storages));
+	li->storages[li->nr_storages++] = storage;
+}
+
+static int interval_start_cmp(const void *_a, const void *_b)
+{
+	const struct live_interval *a = _a, *b = _b;
+
+	if (a->start != b->start)
+		return a->start - b->start;
+	return a->first - b->first;
+}
+
+static int pick_reg(struct live_interval *li, unsigned int free)
+{
+	/* Across a call: what survives it, else: what doesn't */
+	unsigned int prefer = li->calls ? ~CALL_CLOBBERED : CALL_CLOBBERED;
+	int i;
+
+	if (free & prefer)
+		free &= prefer;
+	for (i = 0; i < REGNO; i++) {
+		if (free & (1 << i))
+			return i;
+	}
+	return -1;
+}
+
+static void spill_interval(struct live_interval *li)
+{
+	int offset = alloc_stack_offset(4), i;
+
+	li->regno = -1;
+	for (i = 0; i < li->nr_storages; i++) {
+		li->storages[i]->type = REG_STACK;
+		li->storages[i]->offset = offset;
+	}
+}
+
+static void linear_scan(struct live_interval *intervals, int nr)
+{
+	int i, j;
+
+	for (i = 0; i < nr; i++) {
+		struct live_interval *li = intervals + i;
+		unsigned int free = (1 << REGNO) - 1, blocked = 0;
+		long weight[REGNO] = { 0, }, own;
+		int best = -1;
+
+		if (li->fixed)
+			continue;
+
+		/* Who has the registers where we are live? */
+		for (j = 0; j < nr; j++) {
+			struct live_interval *other = intervals + j;
+
+			if (other->regno < 0 || other == li)
+				continue;
+			if (!overlaps(li, other))
+				continue;
+			free &= ~(1 << other->regno);
+			if (other->fixed)
+				blocked |= 1 << other->regno;
+			else
+				weight[other->regno] += spill_weight(other);
+		}
+
+		li->calls = crosses_call(li);
+		li->regno = pick_reg(li, free);
+		if (li->regno >= 0)
+			continue;
+
+		/* Full: spill whatever costs the least, maybe us */
+		for (j = 0; j < REGNO; j++) {
+			if (blocked & (1 << j))
+				continue;
+			if (best < 0 || weight[j] < weight[best])
+				best = j;
+		}
+		own = spill_weight(li);
+		if (best < 0 || weight[best] >= own) {
+			spill_interval(li);
+			continue;
+		}
+		for (j = 0; j < nr; j++) {
+			struct live_interval *other = intervals + j;
+
+			if (other->regno == best && !other->fixed && overlaps(li, other))
+				spill_interval(other);
+		}
+		li->regno = best;
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct live_interval *li = intervals + i;
+		int j;
+
+		for (j = 0; !li->fixed && li->regno >= 0 && j < li->nr_storages; j++) {
+			li->storages[j]->type = REG_REG;
+			li->storages[j]->regno = li->regno;
+		}
+		free(li->storages);
+		free(li->ranges);
+	}
+}
+
+static void allocate_storage(struct entrypoint *ep)
+{
+	int nr_bbs = ptr_list_size((struct ptr_list *)ep->bbs);
+	struct bb_range *ranges = calloc(nr_bbs + 1, sizeof(*ranges));
+	struct interval_hash *hashes = NULL;
+	struct live_interval *intervals;
+	int nr_hashes = 0, nr = 0, i;
+	struct basic_block *bb;
+
+	if (!ranges)
+		die("out of memory");
+	number_bbs(ep, ranges);
+
+	/* All the inter-bb storage, in a stable order */
+	FOR_EACH_PTR(ep->bbs, bb) {
+		enum inout_enum inout;
+
+		for (inout = STOR_IN; inout <= STOR_OUT; inout++) {
+			struct storage_hash_list *list = gather_storage(bb, inout);
+			struct storage_hash *hash;
+
+			FOR_EACH_PTR(list, hash) {
+				switch (hash->storage->type) {
+				case REG_UDEF:
+				case REG_REG:
+					break;
+				default:
+					continue;
+				}
+				hashes = grow_array(hashes, nr_hashes, sizeof(*hashes));
+				hashes[nr_hashes].hash = hash;
+				hashes[nr_hashes].nr = nr_hashes;
+				nr_hashes++;
+			} END_FOR_EACH_PTR(hash);
+			free_ptr_list(&list);
+		}
+	} END_FOR_EACH_PTR(bb);
+
+	/* One interval per storage, or per pseudo */
+	intervals = calloc(nr_hashes + 1, sizeof(*intervals));
+	if (!intervals)
+		die("out of memory");
+	set_interval_keys(hashes, nr_hashes);
+	for (i = 0; i < nr_hashes; i++) {
+		struct storage_hash *hash = hashes[i].hash;
+		struct live_interval *li = intervals + nr - 1;
+
+		if (!i || hashes[i].key != hashes[i - 1].key) {
+			if (nr)
+				finish_interval(li);
+			li = intervals + nr++;
+			li->first = hashes[i].nr;
+			li->fixed = hash->storage->type == REG_REG;
+			li->regno = li->fixed ? hash->storage->regno : -1;
+		}
+		add_interval_storage(li, hash->storage);
+		add_to_interval(li, hash);
+	}
+	if (nr)
+		finish_interval(intervals + nr - 1);
+
+	qsort(intervals, nr, sizeof(*intervals), interval_start_cmp);
+	linear_scan(intervals, nr);
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		bb->priv = NULL;
+	} END_FOR_EACH_PTR(bb);
+	free(intervals);
+	free(hashes);
+	free(ranges);
+}
+
 static void output(struct entrypoint *ep)
 {
 	unsigned long generation = ++bb_generation;
@@ -1919,6 +2391,9 @@ static void output(struct entrypoint *ep)
 	/* Architecture-specific storage rules.. */
 	arch_set_up_storage(ep);
 
+	/* Registers for what lives across bbs */
+	allocate_storage(ep);
+
 	/* Show the results ... */
 	output_bb(ep->entry->bb, generation);
 
@@ -1219,6 +1219,22 @@ static inline int bad_integer_constant_expression(struct expression *expr)
 	return 0;
 }
 
+/*
+ * Array sizes, enumerators and attribute arguments get asked for
+ * their value over and over again. Once expanded, an expression is
+ * either an EXPR_VALUE or will never become one, so remember that
+ * it's been done and don't walk it again.
+ */
+static struct expand_stats {
+	unsigned long hits, expansions;
+} expand_stats;
+
+void show_expand_stats(void)
+{
+	fprintf(stderr, "constant expressions: %lu expanded, %lu cached\n",
+		expand_stats.expansions, expand_stats.hits);
+}
+
 static long long __get_expression_value(struct expression *expr, int strict)
 {
 	long long value, mask;
@@ -1226,12 +1242,19 @@ static long long __get_expression_value(struct expression *expr, int strict)
 
 	if (!expr)
 		return 0;
-	ctype = evaluate_expression(expr);
-	if (!ctype) {
-		expression_error(expr, "bad constant expression type");
-		return 0;
+	if (expr->folded) {
+		expand_stats.hits++;
+		ctype = expr->ctype;
+	} else {
+		ctype = evaluate_expression(expr);
+		if (!ctype) {
+			expression_error(expr, "bad constant expression type");
+			return 0;
+		}
+		expand_expression(expr);
+		expand_stats.expansions++;
+		expr->folded = !conservative;
 	}
-	expand_expression(expr);
 	if (expr->type != EXPR_VALUE) {
 		if (strict != 2)
 			expression_error(expr, "bad constant expression");
@@ -108,8 +108,7 @@ static struct symbol *handle_func(struct token *token)
 	decl->endpos = token->pos;
 
 	/* function-scope, but in NS_SYMBOL */
-	bind_symbol(decl, ident, NS_LABEL);
-	decl->namespace = NS_SYMBOL;
+	bind_symbol_with_scope(decl, ident, NS_SYMBOL, function_scope);
 
 	len = current_fn->ident->len;
 	string = __alloc_string(len + 1);
@@ -120,8 +119,8 @@ static struct symbol *handle_func(struct token *token)
 	decl->initializer = alloc_expression(token->pos, EXPR_STRING);
 	decl->initializer->string = string;
 	decl->initializer->ctype = decl;
-	decl->array_size = alloc_const_expression(token->pos, len + 1);
-	array->array_size = decl->array_size;
+	symbol_cold(decl)->array_size = alloc_const_expression(token->pos, len + 1);
+	symbol_cold(array)->array_size = decl->cold->array_size;
 	decl->bit_size = array->bit_size = bytes_to_bits(len + 1);
 
 	return decl;
@@ -78,6 +78,7 @@ enum {
 struct expression {
 	enum expression_type type:8;
 	unsigned flags:8;
+	unsigned folded:1;	// already expanded by get_expression_value()
 	int op;
 	struct position pos;
 	struct symbol *ctype;
@@ -194,6 +195,7 @@ extern struct symbol *evaluate_statement(struct statement *stmt);
 extern struct symbol *evaluate_expression(struct expression *);
 
 extern int expand_symbol(struct symbol *);
+extern void show_expand_stats(void);
 
 static inline struct expression *alloc_expression(struct position pos, int type)
 {
@@ -250,6 +250,8 @@ void convert_instruction_target(struct instruction *insn, pseudo_t src)
 		if (*pu->userp != VOID) {
 			assert(*pu->userp == target);
 			*pu->userp = src;
+			if (cse_tracking)
+				cse_queue_insn(pu->insn);
 		}
 	} END_FOR_EACH_PTR(pu);
 	concat_user_list(target->users, &src->users);
@@ -593,6 +595,375 @@ void check_access(struct instruction *insn)
 	}
 }
 
+/*
+ * SSA construction for the common case of a local, non-addressable
+ * symbol with several stores, all of the same size.
+ *
+ * Phi-nodes go to the iterated dominance frontier of the storing
+ * blocks, pruned to the blocks where the symbol is live on entry,
+ * and each load is then replaced by the value reaching it down the
+ * dominator tree. Every block is looked at a bounded number of times
+ * per symbol, rather than once per load as find_dominating_stores()
+ * does.
+ *
+ * The per-block state is indexed by the dominator tree postorder
+ * number and tagged with "ssa_stamp", so that nothing needs to be
+ * cleared between two symbols.
+ */
+struct ssa_block {
+	unsigned long stamp;
+	unsigned int flags;
+	unsigned int df_mark;
+	pseudo_t out;
+	struct instruction *phi;
+	struct basic_block_list *frontier;
+};
+
+#define SSA_USE		1	/* loads the symbol */
+#define SSA_DEF		2	/* stores to it */
+#define SSA_LIVE	4	/* the symbol is live on entry */
+#define SSA_QUEUED	8	/* on the phi placement worklist */
+#define SSA_OUT		16	/* ->out is the value on exit (NULL if undefined) */
+
+static struct ssa_block *ssa_blocks;
+static unsigned int ssa_nr, ssa_alloc;
+static unsigned long ssa_stamp;
+static struct basic_block_vec ssa_access, ssa_work, ssa_chain, ssa_phis;
+
+static struct ssa_block *ssa_block(struct basic_block *bb)
+{
+	struct ssa_block *sb = ssa_blocks + bb->postorder;
+
+	if (sb->stamp != ssa_stamp) {
+		sb->stamp = ssa_stamp;
+		sb->flags = 0;
+		sb->phi = NULL;
+	}
+	return sb;
+}
+
+static void ssa_prepare(struct entrypoint *ep)
+{
+	struct basic_block *bb, *parent;
+
+	build_dominator_tree(ep);
+	ssa_nr = ep->entry->bb->postorder + 1;
+	if (ssa_nr > ssa_alloc) {
+		ssa_alloc = ssa_nr * 2;
+		ssa_blocks = realloc(ssa_blocks, ssa_alloc * sizeof(*ssa_blocks));
+		if (!ssa_blocks)
+			die("out of memory for ssa blocks");
+	}
+	memset(ssa_blocks, 0, ssa_nr * sizeof(*ssa_blocks));
+
+	/* Dominance frontiers, Cooper/Harvey/Kennedy style */
+	FOR_EACH_PTR(ep->bbs, bb) {
+		if (!bb->postorder || bb_list_size(bb->parents) < 2)
+			continue;
+		FOR_EACH_PTR(bb->parents, parent) {
+			struct basic_block *runner = parent;
+
+			if (!runner->postorder)
+				continue;
+			while (runner && runner != bb->idom) {
+				struct ssa_block *sb = ssa_blocks + runner->postorder;
+				if (sb->df_mark != bb->postorder) {
+					sb->df_mark = bb->postorder;
+					add_bb(&sb->frontier, bb);
+				}
+				runner = runner->idom;
+			}
+		} END_FOR_EACH_PTR(parent);
+	} END_FOR_EACH_PTR(bb);
+}
+
+static void ssa_release(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < ssa_nr; i++)
+		free_ptr_list(&ssa_blocks[i].frontier);
+	ssa_nr = 0;
+}
+
+static inline int ssa_access_of(struct instruction *insn, pseudo_t pseudo)
+{
+	if (insn->opcode != OP_LOAD && insn->opcode != OP_STORE)
+		return 0;
+	return insn->bb && insn->src == pseudo;
+}
+
+/*
+ * The value of the symbol on exit from "bb": walk up the dominator
+ * tree to the nearest block that stores or has a phi-node, and
+ * remember the answer for all the blocks on the way.
+ */
+static pseudo_t ssa_value_out(struct basic_block *bb)
+{
+	pseudo_t value = NULL;
+
+	reset_ptr_vec(&ssa_chain);
+	for (;;) {
+		struct ssa_block *sb = ssa_block(bb);
+		if (sb->flags & SSA_OUT) {
+			value = sb->out;
+			break;
+		}
+		add_ptr_vec(&ssa_chain, bb);
+		bb = bb->idom;
+		if (!bb)
+			break;
+	}
+	FOR_EACH_VEC(&ssa_chain, bb) {
+		struct ssa_block *sb = ssa_blocks + bb->postorder;
+		sb->out = value;
+		sb->flags |= SSA_OUT;
+	} END_FOR_EACH_VEC(bb);
+	return value;
+}
+
+static pseudo_t ssa_value_in(struct basic_block *bb)
+{
+	struct ssa_block *sb = ssa_block(bb);
+
+	if (sb->phi)
+		return sb->phi->target;
+	return bb->idom ? ssa_value_out(bb->idom) : NULL;
+}
+
+/*
+ * Scan a block that accesses the symbol: is it live on entry?
+ */
+static void ssa_scan_block(struct basic_block *bb, pseudo_t pseudo)
+{
+	struct ssa_block *sb = ssa_block(bb);
+	struct instruction *insn;
+
+	if (!(sb->flags & SSA_DEF)) {
+		sb->flags |= SSA_LIVE;
+		return;
+	}
+	FOR_EACH_PTR(bb->insns, insn) {
+		if (!ssa_access_of(insn, pseudo))
+			continue;
+		if (insn->opcode == OP_LOAD)
+			sb->flags |= SSA_LIVE;
+		return;
+	} END_FOR_EACH_PTR(insn);
+}
+
+/*
+ * Replace the loads in "bb" by the value reaching them. The blocks
+ * are done in dominator tree preorder, so that the value on exit of
+ * every storing block up the tree is known by the time it's needed.
+ */
+static void ssa_rename_block(struct basic_block *bb, pseudo_t pseudo)
+{
+	pseudo_t value = ssa_value_in(bb);
+	struct ssa_block *sb;
+	struct instruction *insn;
+
+	FOR_EACH_PTR(bb->insns, insn) {
+		if (!ssa_access_of(insn, pseudo))
+			continue;
+		if (insn->opcode == OP_STORE) {
+			value = insn->target;
+			continue;
+		}
+		if (!value) {
+			check_access(insn);
+			convert_load_instruction(insn, value_pseudo(0));
+			continue;
+		}
+		convert_load_instruction(insn, value);
+	} END_FOR_EACH_PTR(insn);
+
+	sb = ssa_blocks + bb->postorder;
+	if (sb->flags & SSA_DEF) {
+		sb->out = value;
+		sb->flags |= SSA_OUT;
+	}
+}
+
+static int ssa_dom_order(const void *_a, const void *_b)
+{
+	const struct basic_block *a = _a, *b = _b;
+
+	return a->dom_pre < b->dom_pre ? -1 : a->dom_pre > b->dom_pre;
+}
+
+static void ssa_add_phi_sources(struct basic_block *bb, pseudo_t pseudo)
+{
+	struct instruction *phi_node = ssa_blocks[bb->postorder].phi;
+	struct basic_block *parent;
+
+	FOR_EACH_PTR(bb->parents, parent) {
+		struct instruction *br;
+		pseudo_t value, phi;
+
+		if (!parent->postorder)
+			continue;
+		value = ssa_value_out(parent);
+		if (!value)
+			continue;
+		br = delete_last_instruction(&parent->insns);
+		phi = alloc_phi(parent, value, phi_node->size);
+		phi->ident = pseudo->ident;
+		add_instruction(&parent->insns, br);
+		use_pseudo(phi_node, phi, add_pseudo(&phi_node->phi_list, phi));
+	} END_FOR_EACH_PTR(parent);
+}
+
+/*
+ * A phi-node whose sources, apart from itself, all are the same
+ * value is just that value (or undefined, if it has none left).
+ */
+static int ssa_trivial_phi(struct instruction *phi_node)
+{
+	pseudo_t phi, same = NULL;
+
+	FOR_EACH_PTR(phi_node->phi_list, phi) {
+		pseudo_t src = phi->def->phi_src;
+		if (src == phi_node->target)
+			continue;
+		if (same && same != src)
+			return 0;
+		same = src;
+	} END_FOR_EACH_PTR(phi);
+
+	convert_instruction_target(phi_node, same ? : value_pseudo(0));
+	phi_node->bb = NULL;
+	FOR_EACH_PTR(phi_node->phi_list, phi) {
+		struct instruction *def = phi->def;
+		def->bb = NULL;
+		kill_use(&def->phi_src);
+		kill_use(THIS_ADDRESS(phi));
+	} END_FOR_EACH_PTR(phi);
+	return 1;
+}
+
+static int ssa_convert_symbol(struct entrypoint *ep, pseudo_t pseudo)
+{
+	struct instruction *model = NULL;
+	struct basic_block *bb;
+	struct pseudo_user *pu;
+	int changed;
+
+	if (!ssa_nr)
+		ssa_prepare(ep);
+
+	FOR_EACH_PTR(pseudo->users, pu) {
+		struct instruction *insn = pu->insn;
+
+		if (!ssa_access_of(insn, pseudo))
+			continue;
+		if (!insn->bb->postorder)
+			return 0;
+		if (model && model->size != insn->size)
+			return 0;
+		if (!model || insn->opcode == OP_LOAD)
+			model = insn;
+	} END_FOR_EACH_PTR(pu);
+
+	ssa_stamp++;
+	reset_ptr_vec(&ssa_access);
+	reset_ptr_vec(&ssa_phis);
+	FOR_EACH_PTR(pseudo->users, pu) {
+		struct instruction *insn = pu->insn;
+		struct ssa_block *sb;
+
+		if (!ssa_access_of(insn, pseudo)) {
+			/* Unreachable load? Undo it */
+			if (insn->opcode == OP_LOAD && !insn->bb)
+				insn->opcode = OP_LNOP;
+			continue;
+		}
+		sb = ssa_block(insn->bb);
+		if (!(sb->flags & (SSA_USE | SSA_DEF)))
+			add_ptr_vec(&ssa_access, insn->bb);
+		sb->flags |= insn->opcode == OP_LOAD ? SSA_USE : SSA_DEF;
+	} END_FOR_EACH_PTR(pu);
+
+	/* Where is the symbol live on entry? */
+	reset_ptr_vec(&ssa_work);
+	FOR_EACH_VEC(&ssa_access, bb) {
+		ssa_scan_block(bb, pseudo);
+		if (ssa_blocks[bb->postorder].flags & SSA_LIVE)
+			add_ptr_vec(&ssa_work, bb);
+	} END_FOR_EACH_VEC(bb);
+	while (ptr_vec_size(&ssa_work)) {
+		struct basic_block *parent;
+
+		bb = pop_ptr_vec(&ssa_work);
+		FOR_EACH_PTR(bb->parents, parent) {
+			struct ssa_block *sb;
+
+			if (!parent->postorder)
+				continue;
+			sb = ssa_block(parent);
+			if (sb->flags & (SSA_LIVE | SSA_DEF))
+				continue;
+			sb->flags |= SSA_LIVE;
+			add_ptr_vec(&ssa_work, parent);
+		} END_FOR_EACH_PTR(parent);
+	}
+
+	/* Phi-nodes on the iterated dominance frontier of the stores */
+	FOR_EACH_VEC(&ssa_access, bb) {
+		struct ssa_block *sb = ssa_blocks + bb->postorder;
+		if (sb->flags & SSA_DEF) {
+			sb->flags |= SSA_QUEUED;
+			add_ptr_vec(&ssa_work, bb);
+		}
+	} END_FOR_EACH_VEC(bb);
+	while (ptr_vec_size(&ssa_work)) {
+		struct basic_block *df;
+
+		bb = pop_ptr_vec(&ssa_work);
+		FOR_EACH_PTR(ssa_blocks[bb->postorder].frontier, df) {
+			struct ssa_block *sb = ssa_block(df);
+
+			if (!(sb->flags & SSA_QUEUED)) {
+				sb->flags |= SSA_QUEUED;
+				add_ptr_vec(&ssa_work, df);
+			}
+			if (sb->phi || !(sb->flags & SSA_LIVE))
+				continue;
+			sb->phi = insert_phi_node(df, model->type, model->size);
+			add_ptr_vec(&ssa_phis, df);
+			if (!(sb->flags & SSA_DEF)) {
+				sb->out = sb->phi->target;
+				sb->flags |= SSA_OUT;
+			}
+		} END_FOR_EACH_PTR(df);
+	}
+
+	SORT_PTR_VEC(&ssa_access, ssa_dom_order);
+	FOR_EACH_VEC(&ssa_access, bb) {
+		ssa_rename_block(bb, pseudo);
+	} END_FOR_EACH_VEC(bb);
+	FOR_EACH_VEC(&ssa_phis, bb) {
+		ssa_add_phi_sources(bb, pseudo);
+	} END_FOR_EACH_VEC(bb);
+
+	do {
+		changed = 0;
+		FOR_EACH_VEC(&ssa_phis, bb) {
+			struct instruction *phi_node = ssa_blocks[bb->postorder].phi;
+			if (phi_node->bb && ssa_trivial_phi(phi_node))
+				changed = 1;
+		} END_FOR_EACH_VEC(bb);
+	} while (changed);
+
+	/* All the loads are gone, and so are the stores */
+	FOR_EACH_PTR(pseudo->users, pu) {
+		struct instruction *insn = pu->insn;
+		if (insn->opcode == OP_STORE)
+			kill_store(insn);
+	} END_FOR_EACH_PTR(pu);
+	return 1;
+}
+
 static void simplify_one_symbol(struct entrypoint *ep, struct symbol *sym)
 {
 	pseudo_t pseudo, src;
@@ -672,6 +1043,8 @@ static void simplify_one_symbol(struct entrypoint *ep, struct symbol *sym)
 	return;
 
 multi_def:
+	if (ssa_convert_symbol(ep, pseudo))
+		return;
 complex_def:
 external_visibility:
 	all = 1;
@@ -718,6 +1091,7 @@ void simplify_symbol_usage(struct entrypoint *ep)
 	FOR_EACH_PTR(ep->accesses, pseudo) {
 		simplify_one_symbol(ep, pseudo->sym);
 	} END_FOR_EACH_PTR(pseudo);
+	ssa_release();
 }
 
 static void mark_bb_reachable(struct basic_block *bb, unsigned long generation)
@@ -769,6 +1143,9 @@ void kill_bb(struct basic_block *bb)
 		remove_bb_from_list(&parent->children, bb, 0);
 	} END_FOR_EACH_PTR(parent);
 	bb->parents = NULL;
+
+	/* Nor is it anything's dominator anymore */
+	bb->dom_pre = bb->dom_post = 0;
 }
 
 void kill_unreachable_bbs(struct entrypoint *ep)
@@ -1003,4 +1380,104 @@ out:
 	} END_FOR_EACH_PTR(bb);
 }
 
+/*
+ * Dominator tree, the "simple, fast" iterative way (Cooper, Harvey
+ * and Kennedy): walk the blocks in reverse post-order, intersecting
+ * the dominators of the already handled parents, until nothing
+ * changes. The tree is then numbered in pre- and post-order so that
+ * dominance can be answered by comparing two numbers.
+ *
+ * Blocks not reachable from the entry get no numbers: they neither
+ * dominate nor are dominated by anything.
+ */
+static struct basic_block_vec dom_order;
+
+static void dom_postorder(struct basic_block *bb, unsigned long generation)
+{
+	struct basic_block *child;
+
+	bb->generation = generation;
+	FOR_EACH_PTR(bb->children, child) {
+		if (child->generation != generation)
+			dom_postorder(child, generation);
+	} END_FOR_EACH_PTR(child);
+	add_ptr_vec(&dom_order, bb);
+	bb->postorder = ptr_vec_size(&dom_order);
+}
+
+static struct basic_block *dom_intersect(struct basic_block *bb1, struct basic_block *bb2)
+{
+	while (bb1 != bb2) {
+		while (bb1->postorder < bb2->postorder)
+			bb1 = bb1->idom;
+		while (bb2->postorder < bb1->postorder)
+			bb2 = bb2->idom;
+	}
+	return bb1;
+}
 
+static void dom_number(struct basic_block *bb, unsigned int *nr)
+{
+	struct basic_block *child;
+
+	bb->dom_pre = ++*nr;
+	FOR_EACH_PTR(bb->dom_children, child) {
+		dom_number(child, nr);
+	} END_FOR_EACH_PTR(child);
+	bb->dom_post = ++*nr;
+}
+
+void build_dominator_tree(struct entrypoint *ep)
+{
+	struct basic_block *bb, *entry = ep->entry->bb;
+	unsigned long generation = ++bb_generation;
+	unsigned int nr = 0;
+	int changed;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		bb->idom = NULL;
+		bb->postorder = bb->dom_pre = bb->dom_post = 0;
+		free_ptr_list(&bb->dom_children);
+	} END_FOR_EACH_PTR(bb);
+
+	reset_ptr_vec(&dom_order);
+	dom_postorder(entry, generation);
+
+	entry->idom = entry;
+	do {
+		changed = 0;
+		FOR_EACH_VEC_REVERSE(&dom_order, bb) {
+			struct basic_block *parent, *idom = NULL;
+
+			if (bb == entry)
+				continue;
+			FOR_EACH_PTR(bb->parents, parent) {
+				if (parent->generation != generation || !parent->idom)
+					continue;
+				idom = idom ? dom_intersect(parent, idom) : parent;
+			} END_FOR_EACH_PTR(parent);
+			if (bb->idom != idom) {
+				bb->idom = idom;
+				changed = 1;
+			}
+		} END_FOR_EACH_VEC_REVERSE(bb);
+	} while (changed);
+	entry->idom = NULL;
+
+	FOR_EACH_VEC(&dom_order, bb) {
+		if (bb->idom)
+			add_bb(&bb->idom->dom_children, bb);
+	} END_FOR_EACH_VEC(bb);
+	dom_number(entry, &nr);
+}
+
+/*
+ * Does "bb1" dominate "bb2"? Only valid as long as the
+ * flowgraph didn't change since build_dominator_tree().
+ */
+int bb_dominates(struct basic_block *bb1, struct basic_block *bb2)
+{
+	if (!bb1->dom_pre || !bb2->dom_pre)
+		return 0;
+	return bb1->dom_pre <= bb2->dom_pre && bb2->dom_post <= bb1->dom_post;
+}
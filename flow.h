@@ -19,13 +19,20 @@ extern void pack_basic_blocks(struct entrypoint *ep);
 
 extern void convert_instruction_target(struct instruction *insn, pseudo_t src);
 extern void cleanup_and_cse(struct entrypoint *ep);
+extern void sccp(struct entrypoint *ep);
 extern int simplify_instruction(struct instruction *);
+extern int eval_binop(struct instruction *insn, long long left, long long right, long long *val);
+extern int eval_unop(struct instruction *insn, long long val, long long *res);
+extern int eval_cast(struct instruction *insn, long long val, long long *res);
 
 extern void kill_bb(struct basic_block *);
 extern void kill_use(pseudo_t *);
 extern void kill_instruction(struct instruction *);
 extern void kill_unreachable_bbs(struct entrypoint *ep);
 
+extern void build_dominator_tree(struct entrypoint *ep);
+extern int bb_dominates(struct basic_block *bb1, struct basic_block *bb2);
+
 void check_access(struct instruction *insn);
 void convert_load_instruction(struct instruction *, pseudo_t);
 void rewrite_load_instruction(struct instruction *, struct pseudo_list *);
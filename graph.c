@@ -38,6 +38,12 @@
 #include "expression.h"
 #include "linearize.h"
 
+/* With -fjobs=N every file is graphed by a worker process of its own;
+ * the node names get the file's index as prefix to keep them apart,
+ * and the inter-file calls are written to "edges" for the final link */
+static char tu_prefix[16];
+static FILE *edges;
+
 
 /* Draw the subgraph for a given entrypoint. Includes details of loads
  * and stores for globals, and marks return bbs */
@@ -51,7 +57,7 @@ static void graph_ep(struct entrypoint *ep)
 	fname = show_ident(ep->name->ident);
 	sname = stream_name(ep->entry->bb->pos.stream);
 
-	printf("subgraph cluster%p {\n"
+	printf("subgraph cluster%s%p {\n"
 	       "    color=blue;\n"
 	       "    label=<<TABLE BORDER=\"0\" CELLBORDER=\"0\">\n"
 	       "             <TR><TD>%s</TD></TR>\n"
@@ -59,8 +65,8 @@ static void graph_ep(struct entrypoint *ep)
 	       "           </TABLE>>;\n"
 	       "    file=\"%s\";\n"
 	       "    fun=\"%s\";\n"
-	       "    ep=bb%p;\n",
-	       ep, sname, fname, sname, fname, ep->entry->bb);
+	       "    ep=bb%s%p;\n",
+	       tu_prefix, ep, sname, fname, sname, fname, tu_prefix, ep->entry->bb);
 
 	FOR_EACH_PTR(ep->bbs, bb) {
 		struct basic_block *child;
@@ -68,8 +74,8 @@ static void graph_ep(struct entrypoint *ep)
 		const char * s = ", ls=\"[";
 
 		/* Node for the bb */
-		printf("    bb%p [shape=ellipse,label=%d,line=%d,col=%d",
-		       bb, bb->pos.line, bb->pos.line, bb->pos.pos);
+		printf("    bb%s%p [shape=ellipse,label=%d,line=%d,col=%d",
+		       tu_prefix, bb, bb->pos.line, bb->pos.line, bb->pos.pos);
 
 
 		/* List loads and stores */
@@ -103,7 +109,8 @@ static void graph_ep(struct entrypoint *ep)
 
 		/* Edges between bbs; lower weight for upward edges */
 		FOR_EACH_PTR(bb->children, child) {
-			printf("    bb%p -> bb%p [op=br, %s];\n", bb, child,
+			printf("    bb%s%p -> bb%s%p [op=br, %s];\n",
+			       tu_prefix, bb, tu_prefix, child,
 			       (bb->pos.line > child->pos.line) ? "weight=5" : "weight=10");
 		} END_FOR_EACH_PTR(child);
 	} END_FOR_EACH_PTR(bb);
@@ -135,22 +142,26 @@ static void graph_calls(struct entrypoint *ep, int internal)
 
 				/* Find the symbol for the callee's definition */
 				struct symbol * sym;
-				if (insn->func->type == PSEUDO_SYM) {
-					for (sym = insn->func->sym->ident->symbols;
+				if (insn->func->type == PSEUDO_SYM && edges && !internal) {
+					fprintf(edges, "C bb%s%p %d %d %s\n",
+						tu_prefix, bb, insn->pos.line, insn->pos.pos,
+						show_pseudo(insn->func));
+				} else if (insn->func->type == PSEUDO_SYM) {
+					for (sym = *ident_symbols(insn->func->sym->ident, NS_SYMBOL);
 					     sym; sym = sym->next_id) {
-						if (sym->namespace & NS_SYMBOL && sym->ep)
+						if (sym->namespace & NS_SYMBOL && cold_field(sym, ep))
 							break;
 					}
 
 					if (sym)
-						printf("bb%p -> bb%p"
+						printf("bb%s%p -> bb%s%p"
 						       "[label=%d,line=%d,col=%d,op=call,style=bold,weight=30];\n",
-						       bb, sym->ep->entry->bb,
+						       tu_prefix, bb, tu_prefix, sym->cold->ep->entry->bb,
 						       insn->pos.line, insn->pos.line, insn->pos.pos);
 					else
-						printf("bb%p -> \"%s\" "
+						printf("bb%s%p -> \"%s\" "
 						       "[label=%d,line=%d,col=%d,op=extern,style=dashed];\n",
-						       bb, show_pseudo(insn->func),
+						       tu_prefix, bb, show_pseudo(insn->func),
 						       insn->pos.line, insn->pos.line, insn->pos.pos);
 				}
 			}
@@ -158,6 +169,142 @@ static void graph_calls(struct entrypoint *ep, int internal)
 	} END_FOR_EACH_PTR(bb);
 }
 
+
+/* Linearize all symbols of a file, graph internal basic block
+ * structures and intra-file calls */
+static struct symbol_list *graph_file(char *file)
+{
+	struct symbol_list *fsyms = sparse(file);
+	struct symbol *sym;
+
+	FOR_EACH_PTR(fsyms, sym) {
+		expand_symbol(sym);
+		linearize_symbol(sym);
+	} END_FOR_EACH_PTR(sym);
+
+	FOR_EACH_PTR(fsyms, sym) {
+		if (cold_field(sym, ep)) {
+			graph_ep(sym->cold->ep);
+			graph_calls(sym->cold->ep, 1);
+		}
+	} END_FOR_EACH_PTR_NOTAG(sym);
+
+	return fsyms;
+}
+
+
+/* The whole-program mode: each file is graphed by a worker, which
+ * writes its inter-file calls and its visible functions as "edges",
+ * and the calls are linked once all of them are done */
+struct graph_edge {
+	char *from, *to;
+	int line, col;
+};
+
+static struct graph_edge *calls, *defs;
+static int nr_calls, nr_defs, max_calls, max_defs;
+
+static void add_edge(struct graph_edge **list, int *nr, int *max,
+		     char *from, char *to, int line, int col)
+{
+	struct graph_edge *e;
+
+	if (*nr == *max) {
+		*max = *max ? *max * 2 : 256;
+		*list = realloc(*list, *max * sizeof(**list));
+		if (!*list)
+			die("out of memory");
+	}
+	e = *list + (*nr)++;
+	e->from = strdup(from);
+	e->to = strdup(to);
+	e->line = line;
+	e->col = col;
+}
+
+/* A worker: graph the file and list the functions it makes visible
+ * to the others */
+static void graph_worker(char *file, int tu, FILE *data)
+{
+	struct symbol_list *fsyms;
+	struct symbol *sym;
+
+	snprintf(tu_prefix, sizeof(tu_prefix), "%d_", tu);
+	edges = data;
+	fsyms = graph_file(file);
+
+	FOR_EACH_PTR(fsyms, sym) {
+		struct entrypoint *ep = cold_field(sym, ep);
+		if (ep && !(sym->ctype.modifiers & MOD_STATIC))
+			fprintf(edges, "D bb%s%p 0 0 %s\n", tu_prefix,
+				ep->entry->bb, show_ident(sym->ident));
+		if (ep)
+			graph_calls(ep, 0);
+	} END_FOR_EACH_PTR(sym);
+}
+
+/* Keep the edges of a worker for the link */
+static void merge_edges(char *file, FILE *data)
+{
+	char *line = NULL;
+	size_t size = 0;
+
+	while (getline(&line, &size, data) > 0) {
+		char kind, from[64];
+		int pos, line_nr, col;
+
+		line[strcspn(line, "\n")] = '\0';
+		if (sscanf(line, "%c %63s %d %d %n", &kind, from, &line_nr, &col, &pos) != 4)
+			die("graph: bad edge from %s: '%s'", file, line);
+		if (kind == 'D')
+			add_edge(&defs, &nr_defs, &max_defs, line + pos, from, nr_defs, 0);
+		else
+			add_edge(&calls, &nr_calls, &max_calls, from, line + pos, line_nr, col);
+	}
+	free(line);
+}
+
+static int compare_names(const void *_a, const void *_b)
+{
+	const struct graph_edge *a = _a, *b = _b;
+	return strcmp(a->from, b->from);
+}
+
+/* The same name defined twice: the first file wins */
+static int compare_defs(const void *_a, const void *_b)
+{
+	const struct graph_edge *a = _a, *b = _b;
+	int cmp = strcmp(a->from, b->from);
+	return cmp ? cmp : a->line - b->line;
+}
+
+/* Draw the inter-file calls, to the definition of the callee if some
+ * file has one, and to the bare name otherwise */
+static void link_calls(void)
+{
+	int i;
+
+	qsort(defs, nr_defs, sizeof(*defs), compare_defs);
+	for (i = 0; i < nr_calls; i++) {
+		struct graph_edge *call = calls + i, key, *def;
+
+		key.from = call->to;
+		def = bsearch(&key, defs, nr_defs, sizeof(*defs), compare_names);
+		while (def && def > defs && !compare_names(def - 1, def))
+			def--;
+		if (def)
+			printf("%s -> %s"
+			       "[label=%d,line=%d,col=%d,op=call,style=bold,weight=30];\n",
+			       call->from, def->to,
+			       call->line, call->line, call->col);
+		else
+			printf("%s -> \"%s\" "
+			       "[label=%d,line=%d,col=%d,op=extern,style=dashed];\n",
+			       call->from, call->to,
+			       call->line, call->line, call->col);
+	}
+}
+
 int main(int argc, char **argv)
 {
 	struct string_list *filelist = NULL;
@@ -170,31 +317,22 @@ int main(int argc, char **argv)
 	fsyms = sparse_initialize(argc, argv, &filelist);
 	concat_symbol_list(fsyms, &all_syms);
 
-	/* Linearize all symbols, graph internal basic block
-	 * structures and intra-file calls */
-	FOR_EACH_PTR_NOTAG(filelist, file) {
+	if (parallel_jobs) {
+		run_workers(filelist, graph_worker, merge_edges);
+		link_calls();
+		printf("}\n");
+		return 0;
+	}
 
-		fsyms = sparse(file);
+	FOR_EACH_PTR_NOTAG(filelist, file) {
+		fsyms = graph_file(file);
 		concat_symbol_list(fsyms, &all_syms);
-
-		FOR_EACH_PTR(fsyms, sym) {
-			expand_symbol(sym);
-			linearize_symbol(sym);
-		} END_FOR_EACH_PTR(sym);
-
-		FOR_EACH_PTR(fsyms, sym) {
-			if (sym->ep) {
-				graph_ep(sym->ep);
-				graph_calls(sym->ep, 1);
-			}
-		} END_FOR_EACH_PTR_NOTAG(sym);
-
 	} END_FOR_EACH_PTR_NOTAG(file);
 
 	/* Graph inter-file calls */
 	FOR_EACH_PTR(all_syms, sym) {
-		if (sym->ep)
-			graph_calls(sym->ep, 0);
+		if (cold_field(sym, ep))
+			graph_calls(sym->cold->ep, 0);
 	} END_FOR_EACH_PTR_NOTAG(sym);
 
 	printf("}\n");
@@ -516,7 +516,7 @@ int inline_function(struct expression *expr, struct symbol *sym)
 	struct symbol *name;
 	struct expression *arg;
 
-	if (!fn->inline_stmt) {
+	if (!cold_field(fn, inline_stmt)) {
 		sparse_error(fn->pos, "marked inline, but without a definition");
 		return 0;
 	}
@@ -531,7 +531,7 @@ int inline_function(struct expression *expr, struct symbol *sym)
 	expr->statement = stmt;
 	expr->ctype = fn->ctype.base_type;
 
-	fn_symbol_list = create_symbol_list(sym->inline_symbol_list);
+	fn_symbol_list = create_symbol_list(sym->cold->inline_symbol_list);
 
 	arg_decl = NULL;
 	PREPARE_PTR_LIST(name_list, name);
@@ -551,7 +551,7 @@ int inline_function(struct expression *expr, struct symbol *sym)
 	} END_FOR_EACH_PTR(arg);
 	FINISH_PTR_LIST(name);
 
-	copy_statement(fn->inline_stmt, stmt);
+	copy_statement(fn->cold->inline_stmt, stmt);
 
 	if (arg_decl) {
 		struct statement *decl = alloc_statement(expr->pos, STMT_DECLARATION);
@@ -574,12 +574,12 @@ void uninline(struct symbol *sym)
 	struct symbol_list *arg_list = fn->arguments;
 	struct symbol *p;
 
-	sym->symbol_list = create_symbol_list(sym->inline_symbol_list);
+	sym->symbol_list = create_symbol_list(sym->cold->inline_symbol_list);
 	FOR_EACH_PTR(arg_list, p) {
 		p->replace = p;
 	} END_FOR_EACH_PTR(p);
 	fn->stmt = alloc_statement(fn->pos, STMT_COMPOUND);
-	copy_statement(fn->inline_stmt, fn->stmt);
+	copy_statement(fn->cold->inline_stmt, fn->stmt);
 	unset_replace_list(sym->symbol_list);
 	unset_replace_list(arg_list);
 }
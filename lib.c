@@ -235,6 +235,19 @@ int Wvla = 1;
 
 int dbg_entry = 0;
 int dbg_dead = 0;
+int dbg_stats = 0;
+
+int sort_threads = 0;
+int parallel_jobs = 0;
+int worker_memory = 0;
+int fsccp = 0;
+int fpass_stats = 0;
+int flinearize_all = 0;
+int fincremental = 0;
+int pass_stats_top = 10;
+const char *pass_stats_json = NULL;
+const char *dissect_binary = NULL;
+const char *dissect_dump = NULL;
 
 int preprocess_only;
 
@@ -499,6 +512,7 @@ static char **handle_switch_W(char *arg, char **next)
 static struct warning debugs[] = {
 	{ "entry", &dbg_entry},
 	{ "dead", &dbg_dead},
+	{ "stats", &dbg_stats},
 };
 
 
@@ -553,9 +567,17 @@ static void handle_switch_W_finalize(void)
 	}
 }
 
+static void show_stats(void)
+{
+	show_lookup_stats();
+	show_expand_stats();
+}
+
 static void handle_switch_v_finalize(void)
 {
 	handle_onoff_switch_finalize(debugs, ARRAY_SIZE(debugs));
+	if (dbg_stats)
+		atexit(show_stats);
 }
 
 static char **handle_switch_U(char *arg, char **next)
@@ -591,22 +613,125 @@ static char **handle_switch_ftabstop(char *arg, char **next)
 	return next;
 }
 
+static char **handle_switch_fsort_threads(char *arg, char **next)
+{
+	char *end;
+	unsigned long val;
+
+	if (*arg == '\0')
+		die("error: missing argument to \"-fsort-threads=\"");
+
+	/* 0 means "one per CPU", silly values are ignored */
+	val = strtoul(arg, &end, 10);
+	if (*end == '\0' && val <= 64)
+		sort_threads = val;
+
+	return next;
+}
+
+static char **handle_switch_fjobs(char *arg, char **next)
+{
+	char *end;
+	long val;
+
+	if (*arg == '\0')
+		die("error: missing argument to \"-fjobs=\"");
+
+	/* 0 means "one per CPU", silly values are ignored */
+	val = strtol(arg, &end, 10);
+	if (*end != '\0' || val < 0 || val > 256)
+		return next;
+	if (!val)
+		val = sysconf(_SC_NPROCESSORS_ONLN);
+	parallel_jobs = val > 0 ? val : 1;
+
+	return next;
+}
+
+static char **handle_switch_fworker_memory(char *arg, char **next)
+{
+	char *end;
+	long val;
+
+	if (*arg == '\0')
+		die("error: missing argument to \"-fworker-memory=\"");
+
+	/* In megabytes, 0 means no limit */
+	val = strtol(arg, &end, 10);
+	if (*end == '\0' && val >= 0 && val <= (1L << 30))
+		worker_memory = val;
+
+	return next;
+}
+
+static char **handle_switch_fpass_stats(char *arg, char **next)
+{
+	char *end;
+	long val;
+
+	/* How many of the slowest functions to show */
+	val = strtol(arg, &end, 10);
+	if (*end == '\0' && val >= 0)
+		pass_stats_top = val;
+	fpass_stats = 1;
+
+	return next;
+}
+
+static struct warning fflags[] = {
+	{ "sccp", &fsccp },
+	{ "pass-stats", &fpass_stats },
+	{ "linearize-all", &flinearize_all },
+	{ "incremental", &fincremental },
+};
+
 static char **handle_switch_f(char *arg, char **next)
 {
+	char **ret;
+
 	arg++;
 
 	if (!strncmp(arg, "tabstop=", 8))
 		return handle_switch_ftabstop(arg+8, next);
+	if (!strncmp(arg, "sort-threads=", 13))
+		return handle_switch_fsort_threads(arg+13, next);
+	if (!strncmp(arg, "dissect-binary=", 15)) {
+		dissect_binary = arg + 15;
+		return next;
+	}
+	if (!strncmp(arg, "dissect-dump", 12) && (!arg[12] || arg[12] == '=')) {
+		dissect_dump = arg[12] ? arg + 13 : "";
+		return next;
+	}
+	if (!strncmp(arg, "jobs=", 5))
+		return handle_switch_fjobs(arg+5, next);
+	if (!strncmp(arg, "worker-memory=", 14))
+		return handle_switch_fworker_memory(arg+14, next);
+	if (!strncmp(arg, "pass-stats-json=", 16)) {
+		pass_stats_json = arg + 16;
+		fpass_stats = 1;
+		return next;
+	}
+	if (!strncmp(arg, "pass-stats=", 11))
+		return handle_switch_fpass_stats(arg+11, next);
 
 	/* handle switches w/ arguments above, boolean and only boolean below */
 
-	if (!strncmp(arg, "no-", 3)) {
-		arg += 3;
-	}
-	/* handle switch here.. */
+	ret = handle_onoff_switch(arg - 1, next, fflags, ARRAY_SIZE(fflags));
+	if (ret)
+		return ret;
+
+	/* Unknown, silently ignored */
 	return next;
 }
 
+static void handle_switch_f_finalize(void)
+{
+	handle_onoff_switch_finalize(fflags, ARRAY_SIZE(fflags));
+	if (fpass_stats)
+		atexit(show_pass_stats);
+}
+
 static char **handle_switch_G(char *arg, char **next)
 {
 	if (!strcmp (arg, "G") && *next)
@@ -1056,6 +1181,7 @@ struct symbol_list *sparse_initialize(int argc, char **argv, struct string_list
 	}
 	handle_switch_W_finalize();
 	handle_switch_v_finalize();
+	handle_switch_f_finalize();
 
 	handle_arch_finalize();
 
@@ -1087,6 +1213,7 @@ struct symbol_list * sparse_keep_tokens(char *filename)
 	/* Clear previous symbol list */
 	translation_unit_used_list = NULL;
 
+	pass_stats_file(filename);
 	new_file_scope();
 	res = sparse_file(filename);
 
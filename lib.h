@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdio.h>
 
 /*
  * Basic helper routine descriptions for 'sparse'.
@@ -77,6 +78,11 @@ DECLARE_PTR_LIST(multijmp_list, struct multijmp);
 DECLARE_PTR_LIST(pseudo_list, struct pseudo);
 DECLARE_PTR_LIST(string_list, char);
 
+DECLARE_PTR_VEC(instruction_vec, struct instruction);
+DECLARE_PTR_VEC(basic_block_vec, struct basic_block);
+DECLARE_PTR_VEC(pseudo_vec, struct pseudo);
+DECLARE_PTR_VEC(symbol_vec, struct symbol);
+
 typedef struct pseudo *pseudo_t;
 
 struct token *skip_to(struct token *, int);
@@ -129,6 +135,19 @@ extern int Wvla;
 
 extern int dbg_entry;
 extern int dbg_dead;
+extern int dbg_stats;
+
+extern int sort_threads;
+extern int parallel_jobs;
+extern int worker_memory;
+extern int fsccp;
+extern int fpass_stats;
+extern int flinearize_all;
+extern int fincremental;
+extern int pass_stats_top;
+extern const char *pass_stats_json;
+extern const char *dissect_binary;
+extern const char *dissect_dump;
 
 extern int arch_m64;
 
@@ -139,6 +158,11 @@ extern struct symbol_list *__sparse(char *filename);
 extern struct symbol_list *sparse_keep_tokens(char *filename);
 extern struct symbol_list *sparse(char *filename);
 
+/* worker.c: with -fjobs=N, do each file in a process of its own */
+extern void run_workers(struct string_list *filelist,
+			void (*work)(char *file, int nr, FILE *data),
+			void (*merge)(char *file, FILE *data));
+
 static inline int symbol_list_size(struct symbol_list *list)
 {
 	return ptr_list_size((struct ptr_list *)(list));
@@ -68,6 +68,7 @@ static struct entrypoint *alloc_entrypoint(void)
 static struct basic_block *alloc_basic_block(struct entrypoint *ep, struct position pos)
 {
 	struct basic_block *bb = __alloc_basic_block(0);
+	bb->nr = ++ep->bb_nr;
 	bb->context = -1;
 	bb->pos = pos;
 	bb->ep = ep;
@@ -91,6 +92,18 @@ static inline int regno(pseudo_t n)
 	return retval;
 }
 
+static const char *show_label(struct basic_block *bb)
+{
+	static int n;
+	static char buffer[4][16];
+	char *buf = buffer[3 & ++n];
+
+	if (!bb)
+		return ".L??";
+	snprintf(buf, 16, ".L%u", bb->nr);
+	return buf;
+}
+
 const char *show_pseudo(pseudo_t pseudo)
 {
 	static int n;
@@ -109,7 +122,7 @@ const char *show_pseudo(pseudo_t pseudo)
 		struct expression *expr;
 
 		if (sym->bb_target) {
-			snprintf(buf, 64, ".L%p", sym->bb_target);
+			snprintf(buf, 64, "%s", show_label(sym->bb_target));
 			break;
 		}
 		if (sym->ident) {
@@ -303,10 +316,10 @@ const char *show_instruction(struct instruction *insn)
 		break;
 	case OP_BR:
 		if (insn->bb_true && insn->bb_false) {
-			buf += sprintf(buf, "%s, .L%p, .L%p", show_pseudo(insn->cond), insn->bb_true, insn->bb_false);
+			buf += sprintf(buf, "%s, %s, %s", show_pseudo(insn->cond), show_label(insn->bb_true), show_label(insn->bb_false));
 			break;
 		}
-		buf += sprintf(buf, ".L%p", insn->bb_true ? insn->bb_true : insn->bb_false);
+		buf += sprintf(buf, "%s", show_label(insn->bb_true ? insn->bb_true : insn->bb_false));
 		break;
 
 	case OP_SYMADDR: {
@@ -314,7 +327,7 @@ const char *show_instruction(struct instruction *insn)
 		buf += sprintf(buf, "%s <- ", show_pseudo(insn->target));
 
 		if (sym->bb_target) {
-			buf += sprintf(buf, ".L%p", sym->bb_target);
+			buf += sprintf(buf, "%s", show_label(sym->bb_target));
 			break;
 		}
 		if (sym->ident) {
@@ -348,7 +361,7 @@ const char *show_instruction(struct instruction *insn)
 			buf += sprintf(buf, "%s", show_ident(expr->symbol->ident));
 			break;
 		case EXPR_LABEL:
-			buf += sprintf(buf, ".L%p", expr->symbol->bb_target);
+			buf += sprintf(buf, "%s", show_label(expr->symbol->bb_target));
 			break;
 		default:
 			buf += sprintf(buf, "SETVAL EXPR TYPE %d", expr->type);
@@ -360,11 +373,11 @@ const char *show_instruction(struct instruction *insn)
 		buf += sprintf(buf, "%s", show_pseudo(insn->target));
 		FOR_EACH_PTR(insn->multijmp_list, jmp) {
 			if (jmp->begin == jmp->end)
-				buf += sprintf(buf, ", %d -> .L%p", jmp->begin, jmp->target);
+				buf += sprintf(buf, ", %d -> %s", jmp->begin, show_label(jmp->target));
 			else if (jmp->begin < jmp->end)
-				buf += sprintf(buf, ", %d ... %d -> .L%p", jmp->begin, jmp->end, jmp->target);
+				buf += sprintf(buf, ", %d ... %d -> %s", jmp->begin, jmp->end, show_label(jmp->target));
 			else
-				buf += sprintf(buf, ", default -> .L%p", jmp->target);
+				buf += sprintf(buf, ", default -> %s", show_label(jmp->target));
 		} END_FOR_EACH_PTR(jmp);
 		break;
 	}
@@ -372,7 +385,7 @@ const char *show_instruction(struct instruction *insn)
 		struct multijmp *jmp;
 		buf += sprintf(buf, "%s", show_pseudo(insn->target));
 		FOR_EACH_PTR(insn->multijmp_list, jmp) {
-			buf += sprintf(buf, ", .L%p", jmp->target);
+			buf += sprintf(buf, ", %s", show_label(jmp->target));
 		} END_FOR_EACH_PTR(jmp);
 		break;
 	}
@@ -473,7 +486,7 @@ void show_bb(struct basic_block *bb)
 {
 	struct instruction *insn;
 
-	printf(".L%p:\n", bb);
+	printf("%s:\n", show_label(bb));
 	if (verbose) {
 		pseudo_t needs, defines;
 		printf("%s:%d\n", stream_name(bb->pos.stream), bb->pos.line);
@@ -481,7 +494,7 @@ void show_bb(struct basic_block *bb)
 		FOR_EACH_PTR(bb->needs, needs) {
 			struct instruction *def = needs->def;
 			if (def->opcode != OP_PHI) {
-				printf("  **uses %s (from .L%p)**\n", show_pseudo(needs), def->bb);
+				printf("  **uses %s (from %s)**\n", show_pseudo(needs), show_label(def->bb));
 			} else {
 				pseudo_t phi;
 				const char *sep = " ";
@@ -489,7 +502,7 @@ void show_bb(struct basic_block *bb)
 				FOR_EACH_PTR(def->phi_list, phi) {
 					if (phi == VOID)
 						continue;
-					printf("%s(%s:.L%p)", sep, show_pseudo(phi), phi->def->bb);
+					printf("%s(%s:%s)", sep, show_pseudo(phi), show_label(phi->def->bb));
 					sep = ", ";
 				} END_FOR_EACH_PTR(phi);		
 				printf(")**\n");
@@ -827,6 +840,29 @@ pseudo_t alloc_phi(struct basic_block *source, pseudo_t pseudo, int size)
 	return phi;
 }
 
+/*
+ * Put a new phi-node, with an empty phi-list, at the top of "bb"
+ * (after the OP_ENTRY if this is the entry block).
+ */
+struct instruction *insert_phi_node(struct basic_block *bb, struct symbol *type, int size)
+{
+	struct instruction *phi_node = alloc_instruction(OP_PHI, size);
+	struct instruction *insn;
+
+	phi_node->type = type;
+	phi_node->pos = bb->pos;
+	phi_node->bb = bb;
+	phi_node->target = alloc_pseudo(phi_node);
+	FOR_EACH_PTR(bb->insns, insn) {
+		if (insn->opcode == OP_ENTRY)
+			continue;
+		INSERT_CURRENT(phi_node, insn);
+		return phi_node;
+	} END_FOR_EACH_PTR(insn);
+	add_instruction(&bb->insns, phi_node);
+	return phi_node;
+}
+
 /*
  * We carry the "access_data" structure around for any accesses,
  * which simplifies things a lot. It contains all the access
@@ -916,6 +952,7 @@ static pseudo_t add_load(struct entrypoint *ep, struct access_data *ad)
 
 	insn->target = new;
 	insn->offset = ad->offset;
+	insn->is_volatile = ad->result_type && (ad->result_type->ctype.modifiers & MOD_VOLATILE);
 	use_pseudo(insn, ad->address, &insn->src);
 	add_one_insn(ep, insn);
 	return new;
@@ -2124,7 +2161,7 @@ static struct entrypoint *linearize_fn(struct symbol *sym, struct symbol *base_t
 	struct symbol *arg;
 	struct instruction *entry;
 	pseudo_t result;
-	int i;
+	int i, changed;
 
 	if (!base_type->stmt)
 		return NULL;
@@ -2133,7 +2170,8 @@ static struct entrypoint *linearize_fn(struct symbol *sym, struct symbol *base_t
 	bb = alloc_basic_block(ep, sym->pos);
 	
 	ep->name = sym;
-	sym->ep = ep;
+	symbol_cold(sym)->ep = ep;
+	pass_stats_function(ep);
 	set_activeblock(ep, bb);
 
 	entry = alloc_instruction(OP_ENTRY, 0);
@@ -2157,17 +2195,32 @@ static struct entrypoint *linearize_fn(struct symbol *sym, struct symbol *base_t
 			use_pseudo(insn, result, &insn->src);
 		add_one_insn(ep, insn);
 	}
+	pass_stats_leave(ep);
 
 	/*
 	 * Do trivial flow simplification - branches to
 	 * branches, kill dead basicblocks etc
 	 */
+	pass_stats_enter(ep, PASS_UNREACHABLE);
 	kill_unreachable_bbs(ep);
+	pass_stats_leave(ep);
 
 	/*
 	 * Turn symbols into pseudos
 	 */
+	pass_stats_enter(ep, PASS_SYMBOLS);
 	simplify_symbol_usage(ep);
+	pass_stats_leave(ep);
+
+	/*
+	 * Propagate constants along the paths that can
+	 * be taken, and drop the ones that can't.
+	 */
+	if (fsccp) {
+		pass_stats_enter(ep, PASS_SCCP);
+		sccp(ep);
+		pass_stats_leave(ep);
+	}
 
 repeat:
 	/*
@@ -2175,18 +2228,26 @@ repeat:
 	 * the rest.
 	 */
 	do {
+		pass_stats_enter(ep, PASS_CSE);
 		cleanup_and_cse(ep);
+		pass_stats_leave(ep);
+		pass_stats_enter(ep, PASS_PACK);
 		pack_basic_blocks(ep);
+		pass_stats_leave(ep);
 	} while (repeat_phase & REPEAT_CSE);
 
+	pass_stats_enter(ep, PASS_UNREACHABLE);
 	kill_unreachable_bbs(ep);
+	pass_stats_leave(ep);
 	vrfy_flow(ep);
 
 	/* Cleanup */
 	clear_symbol_pseudos(ep);
 
 	/* And track pseudo register usage */
+	pass_stats_enter(ep, PASS_LIVENESS);
 	track_pseudo_liveness(ep);
+	pass_stats_leave(ep);
 
 	/*
 	 * Some flow optimizations can only effectively
@@ -2194,15 +2255,22 @@ repeat:
 	 * if they trigger, we need to start all over
 	 * again
 	 */
-	if (simplify_flow(ep)) {
+	pass_stats_enter(ep, PASS_FLOW);
+	changed = simplify_flow(ep);
+	if (changed)
 		clear_liveness(ep);
+	pass_stats_leave(ep);
+	if (changed)
 		goto repeat;
-	}
 
 	/* Finally, add deathnotes to pseudos now that we have them */
-	if (dbg_dead)
+	if (dbg_dead) {
+		pass_stats_enter(ep, PASS_DEATH);
 		track_pseudo_death(ep);
+		pass_stats_leave(ep);
+	}
 
+	pass_stats_done(ep);
 	return ep;
 }
 
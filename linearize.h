@@ -70,6 +70,7 @@ DECLARE_ALLOCATOR(asm_rules);
 struct instruction {
 	unsigned opcode:8,
 		 size:24;
+	unsigned queued:1;		/* on the CSE worklist */
 	struct basic_block *bb;
 	struct position pos;
 	struct symbol *type;
@@ -98,6 +99,7 @@ struct instruction {
 			pseudo_t src;
 			struct symbol *orig_type;	/* casts */
 			unsigned int offset;		/* memops */
+			unsigned int is_volatile:1;	/* memops */
 		};
 		struct /* binops and sel */ {
 			pseudo_t src1, src2, src3;
@@ -226,6 +228,7 @@ struct instruction_list;
 
 struct basic_block {
 	struct position pos;
+	unsigned int nr;		/* Label number, unique in its entrypoint */
 	unsigned long generation;
 	int context;
 	struct entrypoint *ep;
@@ -234,6 +237,11 @@ struct basic_block {
 	struct instruction_list *insns;	/* Linear list of instructions */
 	struct pseudo_list *needs, *defines;
 	void *priv;
+
+	/* Dominator tree, see build_dominator_tree() */
+	struct basic_block *idom;
+	struct basic_block_list *dom_children;
+	unsigned int postorder, dom_pre, dom_post;
 };
 
 static inline int is_branch_goto(struct instruction *br)
@@ -304,9 +312,14 @@ static inline struct pseudo_user *alloc_pseudo_user(struct instruction *insn, ps
 	return user;
 }
 
+extern int cse_tracking;
+extern void cse_queue_insn(struct instruction *insn);
+
 static inline void use_pseudo(struct instruction *insn, pseudo_t p, pseudo_t *pp)
 {
 	*pp = p;
+	if (cse_tracking)
+		cse_queue_insn(insn);
 	if (has_use_list(p))
 		add_pseudo_user_ptr(alloc_pseudo_user(insn, pp), &p->users);
 }
@@ -329,15 +342,43 @@ struct entrypoint {
 	struct basic_block_list *bbs;
 	struct basic_block *active;
 	struct instruction *entry;
+	unsigned int bb_nr;		/* Last basic block number handed out */
+
+	/* cleanup_and_cse() statistics, shown with -ventry */
+	unsigned int cse_sweeps;	/* passes over all instructions */
+	unsigned int cse_rounds;	/* all passes, including worklist ones */
+	unsigned int cse_requeued;	/* instructions taken from the worklist */
 };
 
 extern void insert_select(struct basic_block *bb, struct instruction *br, struct instruction *phi, pseudo_t if_true, pseudo_t if_false);
 extern void insert_branch(struct basic_block *bb, struct instruction *br, struct basic_block *target);
 
 pseudo_t alloc_phi(struct basic_block *source, pseudo_t pseudo, int size);
+struct instruction *insert_phi_node(struct basic_block *bb, struct symbol *type, int size);
 pseudo_t alloc_pseudo(struct instruction *def);
 pseudo_t value_pseudo(long long val);
 
+/* The passes linearize_fn() runs, as timed by -fpass-stats */
+enum pass_id {
+	PASS_LINEARIZE,
+	PASS_UNREACHABLE,
+	PASS_SYMBOLS,
+	PASS_SCCP,
+	PASS_CSE,
+	PASS_PACK,
+	PASS_LIVENESS,
+	PASS_FLOW,
+	PASS_DEATH,
+	PASS_NR
+};
+
+extern void pass_stats_file(const char *name);
+extern void pass_stats_function(struct entrypoint *ep);
+extern void pass_stats_enter(struct entrypoint *ep, enum pass_id pass);
+extern void pass_stats_leave(struct entrypoint *ep);
+extern void pass_stats_done(struct entrypoint *ep);
+extern void show_pass_stats(void);
+
 struct entrypoint *linearize_symbol(struct symbol *sym);
 int unssa(struct entrypoint *ep);
 void show_entry(struct entrypoint *ep);
@@ -6,11 +6,14 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "parse.h"
 #include "expression.h"
 #include "linearize.h"
 #include "flow.h"
+#include "bitmap.h"
 
 static void phi_defines(struct instruction * phi_node, pseudo_t target,
 	void (*defines)(struct basic_block *, struct instruction *, pseudo_t))
@@ -184,33 +187,91 @@ static inline int trackable_pseudo(pseudo_t pseudo)
 	return pseudo && (pseudo->type == PSEUDO_REG || pseudo->type == PSEUDO_ARG);
 }
 
+/*
+ * Liveness is solved on bitmaps. The trackable pseudos of the function
+ * get dense numbers (kept in pseudo->priv while we work), and so do the
+ * basic blocks (in bb->priv). Each bb then has a "needs" and a "defines"
+ * bitmap, and needs are pushed up to the parents from a worklist seeded
+ * in post-order, so that children are mostly done before their parents.
+ *
+ * The result is handed out as the bb->needs and bb->defines pseudo
+ * lists, like it always was.
+ */
+static struct pseudo_vec live_pseudos;
+static struct basic_block_vec live_bbs;
+static unsigned long *live_bitmaps;
+static int live_longs;
+
+#define live_nr(p)	((int)(unsigned long)(p)->priv - 1)
+#define bb_needs(bb)	(live_bitmaps + (2 * live_nr(bb)) * live_longs)
+#define bb_defines(bb)	(live_bitmaps + (2 * live_nr(bb) + 1) * live_longs)
+
+static void number_pseudo(struct basic_block *bb, struct instruction *insn, pseudo_t pseudo)
+{
+	if (trackable_pseudo(pseudo) && !pseudo->priv) {
+		add_ptr_vec(&live_pseudos, pseudo);
+		pseudo->priv = (void *)(unsigned long) ptr_vec_size(&live_pseudos);
+	}
+}
+
+static void number_bb(struct basic_block *bb, unsigned long generation)
+{
+	struct basic_block *child;
+
+	bb->generation = generation;
+	FOR_EACH_PTR(bb->children, child) {
+		if (child->generation != generation)
+			number_bb(child, generation);
+	} END_FOR_EACH_PTR(child);
+	add_ptr_vec(&live_bbs, bb);
+	bb->priv = (void *)(unsigned long) ptr_vec_size(&live_bbs);
+}
+
 static void insn_uses(struct basic_block *bb, struct instruction *insn, pseudo_t pseudo)
 {
 	if (trackable_pseudo(pseudo)) {
 		struct instruction *def = pseudo->def;
 		if (pseudo->type != PSEUDO_REG || def->bb != bb || def->opcode == OP_PHI)
-			add_pseudo_exclusive(&bb->needs, pseudo);
+			set_bit(live_nr(pseudo), bb_needs(bb));
 	}
 }
 
 static void insn_defines(struct basic_block *bb, struct instruction *insn, pseudo_t pseudo)
 {
 	assert(trackable_pseudo(pseudo));
-	add_pseudo(&bb->defines, pseudo);
+	set_bit(live_nr(pseudo), bb_defines(bb));
 }
 
-static void track_bb_liveness(struct basic_block *bb)
+/* parent->needs |= bb->needs & ~parent->defines */
+static int track_bb_liveness(struct basic_block *bb, struct basic_block *parent)
 {
-	pseudo_t needs;
+	unsigned long *needs = bb_needs(bb);
+	unsigned long *pneeds = bb_needs(parent);
+	unsigned long *pdefines = bb_defines(parent);
+	int i, changed = 0;
+
+	for (i = 0; i < live_longs; i++) {
+		unsigned long new = needs[i] & ~pdefines[i] & ~pneeds[i];
+		if (new) {
+			pneeds[i] |= new;
+			changed = 1;
+		}
+	}
+	return changed;
+}
 
-	FOR_EACH_PTR(bb->needs, needs) {
-		struct basic_block *parent;
-		FOR_EACH_PTR(bb->parents, parent) {
-			if (!pseudo_in_list(parent->defines, needs)) {
-				add_pseudo_exclusive(&parent->needs, needs);
-			}
-		} END_FOR_EACH_PTR(parent);
-	} END_FOR_EACH_PTR(needs);
+static void bitmap_to_list(unsigned long *bitmap, struct pseudo_list **list)
+{
+	int i;
+
+	for (i = 0; i < live_longs; i++) {
+		unsigned long bits = bitmap[i];
+		while (bits) {
+			int bit = __builtin_ctzl(bits);
+			bits &= bits - 1;
+			add_pseudo(list, live_pseudos.list[i * BITS_IN_LONG + bit]);
+		}
+	}
 }
 
 /*
@@ -233,42 +294,104 @@ void clear_liveness(struct entrypoint *ep)
  */
 void track_pseudo_liveness(struct entrypoint *ep)
 {
+	struct basic_block_vec work = { };
+	unsigned long *used;
+	char *queued;
 	struct basic_block *bb;
+	pseudo_t pseudo;
+	int i;
 
-	/* Add all the bb pseudo usage */
+	/* Number the pseudos and the bbs */
 	FOR_EACH_PTR(ep->bbs, bb) {
 		struct instruction *insn;
 		FOR_EACH_PTR(bb->insns, insn) {
 			if (!insn->bb)
 				continue;
 			assert(insn->bb == bb);
-			track_instruction_usage(bb, insn, insn_defines, insn_uses);
+			track_instruction_usage(bb, insn, number_pseudo, number_pseudo);
 		} END_FOR_EACH_PTR(insn);
 	} END_FOR_EACH_PTR(bb);
 
-	/* Calculate liveness.. */
-	do {
-		liveness_changed = 0;
-		FOR_EACH_PTR_REVERSE(ep->bbs, bb) {
-			track_bb_liveness(bb);
-		} END_FOR_EACH_PTR_REVERSE(bb);
-	} while (liveness_changed);
-
-	/* Remove the pseudos from the "defines" list that are used internally */
+	number_bb(ep->entry->bb, ++bb_generation);
 	FOR_EACH_PTR(ep->bbs, bb) {
-		pseudo_t def;
-		FOR_EACH_PTR(bb->defines, def) {
-			struct basic_block *child;
-			FOR_EACH_PTR(bb->children, child) {
-				if (pseudo_in_list(child->needs, def))
-					goto is_used;
-			} END_FOR_EACH_PTR(child);
-			DELETE_CURRENT_PTR(def);
-is_used:
-		;
-		} END_FOR_EACH_PTR(def);
-		PACK_PTR_LIST(&bb->defines);
+		if (!bb->priv) {
+			add_ptr_vec(&live_bbs, bb);
+			bb->priv = (void *)(unsigned long) ptr_vec_size(&live_bbs);
+		}
 	} END_FOR_EACH_PTR(bb);
+
+	live_longs = BITMAP_LONGS(ptr_vec_size(&live_pseudos) + 1);
+	live_bitmaps = calloc(2 * ptr_vec_size(&live_bbs) * live_longs + live_longs, sizeof(unsigned long));
+	if (!live_bitmaps)
+		die("Unable to allocate liveness bitmaps");
+
+	/* Add all the bb pseudo usage */
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *insn;
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (!insn->bb)
+				continue;
+			track_instruction_usage(bb, insn, insn_defines, insn_uses);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+
+	/* Calculate liveness.. */
+	queued = malloc(ptr_vec_size(&live_bbs));
+	if (!queued)
+		die("Unable to allocate liveness worklist");
+	memset(queued, 1, ptr_vec_size(&live_bbs));
+	FOR_EACH_VEC(&live_bbs, bb) {
+		add_ptr_vec(&work, bb);
+	} END_FOR_EACH_VEC(bb);
+	for (i = 0; i < ptr_vec_size(&work); i++) {
+		struct basic_block *parent;
+
+		bb = work.list[i];
+		queued[live_nr(bb)] = 0;
+		FOR_EACH_PTR(bb->parents, parent) {
+			if (!parent->priv)
+				continue;
+			if (track_bb_liveness(bb, parent) && !queued[live_nr(parent)]) {
+				queued[live_nr(parent)] = 1;
+				add_ptr_vec(&work, parent);
+			}
+		} END_FOR_EACH_PTR(parent);
+	}
+	free_ptr_vec(&work);
+	free(queued);
+
+	/*
+	 * Hand out the result. Only keep the pseudos in "defines"
+	 * that are used by a child, not the internal ones.
+	 */
+	used = live_bitmaps + 2 * ptr_vec_size(&live_bbs) * live_longs;
+	FOR_EACH_VEC(&live_bbs, bb) {
+		struct basic_block *child;
+		unsigned long *defines = bb_defines(bb);
+
+		memset(used, 0, live_longs * sizeof(unsigned long));
+		FOR_EACH_PTR(bb->children, child) {
+			unsigned long *needs = bb_needs(child);
+			for (i = 0; i < live_longs; i++)
+				used[i] |= needs[i];
+		} END_FOR_EACH_PTR(child);
+		for (i = 0; i < live_longs; i++)
+			used[i] &= defines[i];
+
+		bitmap_to_list(bb_needs(bb), &bb->needs);
+		bitmap_to_list(used, &bb->defines);
+	} END_FOR_EACH_VEC(bb);
+
+	FOR_EACH_VEC(&live_bbs, bb) {
+		bb->priv = NULL;
+	} END_FOR_EACH_VEC(bb);
+	FOR_EACH_VEC(&live_pseudos, pseudo) {
+		pseudo->priv = NULL;
+	} END_FOR_EACH_VEC(pseudo);
+	reset_ptr_vec(&live_bbs);
+	reset_ptr_vec(&live_pseudos);
+	free(live_bitmaps);
+	live_bitmaps = NULL;
 }
 
 static void merge_pseudo_list(struct pseudo_list *src, struct pseudo_list **dest)
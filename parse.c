@@ -1627,7 +1627,8 @@ static struct token *abstract_array_declarator(struct token *token, struct symbo
 	if (match_idents(token, &restrict_ident, &__restrict_ident, NULL))
 		token = abstract_array_static_declarator(token->next, &has_static);
 	token = parse_expression(token, &expr);
-	sym->array_size = expr;
+	if (expr)
+		symbol_cold(sym)->array_size = expr;
 	return token;
 }
 
@@ -2465,8 +2466,7 @@ static struct token *label_statement(struct token *token)
 	while (token_type(token) == TOKEN_IDENT) {
 		struct symbol *sym = alloc_symbol(token->pos, SYM_LABEL);
 		/* it's block-scope, but we want label namespace */
-		bind_symbol(sym, token->ident, NS_SYMBOL);
-		sym->namespace = NS_LABEL;
+		bind_symbol_with_scope(sym, token->ident, NS_LABEL, block_scope);
 		fn_local_symbol(sym);
 		token = token->next;
 		if (!match_op(token, ','))
@@ -2690,8 +2690,8 @@ static struct token *parse_function_body(struct token *token, struct symbol *dec
 
 	old_symbol_list = function_symbol_list;
 	if (decl->ctype.modifiers & MOD_INLINE) {
-		function_symbol_list = &decl->inline_symbol_list;
-		p = &base_type->inline_stmt;
+		function_symbol_list = &symbol_cold(decl)->inline_symbol_list;
+		p = &symbol_cold(base_type)->inline_stmt;
 	} else {
 		function_symbol_list = &decl->symbol_list;
 		p = &base_type->stmt;
@@ -2719,16 +2719,16 @@ static struct token *parse_function_body(struct token *token, struct symbol *dec
 	if (!(decl->ctype.modifiers & MOD_INLINE))
 		add_symbol(list, decl);
 	check_declaration(decl);
-	decl->definition = decl;
+	symbol_cold(decl)->definition = decl;
 	prev = decl->same_symbol;
-	if (prev && prev->definition) {
+	if (prev && cold_field(prev, definition)) {
 		warning(decl->pos, "multiple definitions for function '%s'",
 			show_ident(decl->ident));
-		info(prev->definition->pos, " the previous one is here");
+		info(prev->cold->definition->pos, " the previous one is here");
 	} else {
 		while (prev) {
 			rebind_scope(prev, decl->scope);
-			prev->definition = decl;
+			symbol_cold(prev)->definition = decl;
 			prev = prev->same_symbol;
 		}
 	}
@@ -2994,8 +2994,8 @@ struct token *external_declaration(struct token *token, struct symbol_list **lis
 			}
 		}
 		check_declaration(decl);
-		if (decl->same_symbol)
-			decl->definition = decl->same_symbol->definition;
+		if (decl->same_symbol && cold_field(decl->same_symbol, definition))
+			symbol_cold(decl)->definition = decl->same_symbol->cold->definition;
 
 		if (!match_op(token, ','))
 			break;
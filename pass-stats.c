@@ -0,0 +1,403 @@
+/*
+ * pass-stats - time the linearize pipeline, pass by pass.
+ *
+ * With -fpass-stats, every pass linearize_fn() runs on a function is
+ * bracketed by pass_stats_enter() and pass_stats_leave(), which note
+ * the wall time it took and how many instructions and basic blocks
+ * the function had before and after. That is summed up per function
+ * and per translation unit, and shown at exit: a table per pass, and
+ * the slowest functions. -fpass-stats-json=FILE dumps all of it for
+ * scripts to look at.
+ *
+ * Counting the instructions walks the whole function, so this is
+ * only meant to find the inputs that hurt, not to be left on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib.h"
+#include "token.h"
+#include "linearize.h"
+
+static const char *pass_names[PASS_NR] = {
+	[PASS_LINEARIZE]	= "linearize",
+	[PASS_UNREACHABLE]	= "unreachable",
+	[PASS_SYMBOLS]		= "symbols",
+	[PASS_SCCP]		= "sccp",
+	[PASS_CSE]		= "cse",
+	[PASS_PACK]		= "pack",
+	[PASS_LIVENESS]		= "liveness",
+	[PASS_FLOW]		= "flow",
+	[PASS_DEATH]		= "death",
+};
+
+struct pass_stat {
+	unsigned long calls;
+	unsigned long long nsecs;
+	unsigned long insns_in, insns_out;
+	unsigned long bbs_in, bbs_out;
+};
+
+struct fn_stats {
+	struct symbol *sym;
+	int file;
+	unsigned long long nsecs;
+	unsigned long insns, bbs;	/* after linearization */
+	unsigned long insns_out, bbs_out;
+	struct pass_stat pass[PASS_NR];
+};
+
+struct file_stats {
+	const char *name;
+	unsigned long functions;
+	unsigned long long nsecs;
+	struct pass_stat pass[PASS_NR];
+};
+
+static struct fn_stats *fns;
+static unsigned int fns_nr, fns_alloc;
+static struct file_stats *files;
+static unsigned int files_nr, files_alloc;
+
+/* The pass being timed */
+static struct fn_stats *cur_fn;
+static enum pass_id cur_pass;
+static unsigned long long cur_start;
+static unsigned long cur_insns, cur_bbs;
+
+static unsigned long long now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void count_ir(struct entrypoint *ep, unsigned long *insns, unsigned long *bbs)
+{
+	struct basic_block *bb;
+	unsigned long ni = 0, nb = 0;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *insn;
+
+		/* Blocks merged into others are only unlinked later */
+		if (!bb->insns)
+			continue;
+		nb++;
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (insn->bb)
+				ni++;
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+	*insns = ni;
+	*bbs = nb;
+}
+
+static void *grow(void *array, unsigned int nr, unsigned int *alloc, size_t size)
+{
+	if (nr < *alloc)
+		return array;
+	*alloc = *alloc ? *alloc * 2 : 64;
+	array = realloc(array, *alloc * size);
+	if (!array)
+		die("out of memory for pass statistics");
+	return array;
+}
+
+/* A new translation unit starts */
+void pass_stats_file(const char *name)
+{
+	struct file_stats *file;
+
+	if (!fpass_stats)
+		return;
+	files = grow(files, files_nr, &files_alloc, sizeof(*files));
+	file = files + files_nr++;
+	memset(file, 0, sizeof(*file));
+	file->name = name;
+}
+
+void pass_stats_function(struct entrypoint *ep)
+{
+	struct fn_stats *fn;
+
+	if (!fpass_stats)
+		return;
+	/* Things linearized before the first file go to the command line */
+	if (!files_nr)
+		pass_stats_file("<command line>");
+	fns = grow(fns, fns_nr, &fns_alloc, sizeof(*fns));
+	fn = fns + fns_nr++;
+	memset(fn, 0, sizeof(*fn));
+	fn->sym = ep->name;
+	fn->file = files_nr - 1;
+	cur_fn = fn;
+
+	/* Building the IR is the first pass; it starts out empty */
+	cur_pass = PASS_LINEARIZE;
+	cur_insns = cur_bbs = 0;
+	cur_start = now();
+}
+
+void pass_stats_enter(struct entrypoint *ep, enum pass_id pass)
+{
+	if (!cur_fn)
+		return;
+	cur_pass = pass;
+	count_ir(ep, &cur_insns, &cur_bbs);
+	cur_start = now();
+}
+
+void pass_stats_leave(struct entrypoint *ep)
+{
+	unsigned long long nsecs;
+	struct pass_stat *stat;
+	unsigned long insns, bbs;
+
+	if (!cur_fn)
+		return;
+	nsecs = now() - cur_start;
+	count_ir(ep, &insns, &bbs);
+
+	stat = cur_fn->pass + cur_pass;
+	stat->calls++;
+	stat->nsecs += nsecs;
+	stat->insns_in += cur_insns;
+	stat->insns_out += insns;
+	stat->bbs_in += cur_bbs;
+	stat->bbs_out += bbs;
+
+	if (cur_pass == PASS_LINEARIZE) {
+		cur_fn->insns = insns;
+		cur_fn->bbs = bbs;
+	}
+	cur_fn->insns_out = insns;
+	cur_fn->bbs_out = bbs;
+}
+
+void pass_stats_done(struct entrypoint *ep)
+{
+	struct file_stats *file;
+	int i;
+
+	if (!cur_fn)
+		return;
+
+	/* Leave out the time spent counting */
+	file = files + cur_fn->file;
+	file->functions++;
+	for (i = 0; i < PASS_NR; i++) {
+		struct pass_stat *sum = file->pass + i;
+		const struct pass_stat *stat = cur_fn->pass + i;
+
+		cur_fn->nsecs += stat->nsecs;
+		file->nsecs += stat->nsecs;
+		sum->calls += stat->calls;
+		sum->nsecs += stat->nsecs;
+		sum->insns_in += stat->insns_in;
+		sum->insns_out += stat->insns_out;
+		sum->bbs_in += stat->bbs_in;
+		sum->bbs_out += stat->bbs_out;
+	}
+	cur_fn = NULL;
+}
+
+static const char *fn_name(const struct fn_stats *fn)
+{
+	return fn->sym->ident ? show_ident(fn->sym->ident) : "<anonymous>";
+}
+
+static double msecs(unsigned long long nsecs)
+{
+	return nsecs / 1000000.0;
+}
+
+static int slower_fn(const void *a, const void *b)
+{
+	const struct fn_stats *fa = *(const struct fn_stats **)a;
+	const struct fn_stats *fb = *(const struct fn_stats **)b;
+
+	if (fa->nsecs != fb->nsecs)
+		return fa->nsecs < fb->nsecs ? 1 : -1;
+	return fa < fb ? -1 : fa > fb;
+}
+
+static void show_pass_table(void)
+{
+	struct pass_stat total[PASS_NR];
+	unsigned long long nsecs = 0;
+	unsigned int i, j;
+
+	memset(total, 0, sizeof(total));
+	for (i = 0; i < files_nr; i++) {
+		nsecs += files[i].nsecs;
+		for (j = 0; j < PASS_NR; j++) {
+			const struct pass_stat *stat = files[i].pass + j;
+
+			total[j].calls += stat->calls;
+			total[j].nsecs += stat->nsecs;
+			total[j].insns_in += stat->insns_in;
+			total[j].insns_out += stat->insns_out;
+			total[j].bbs_in += stat->bbs_in;
+			total[j].bbs_out += stat->bbs_out;
+		}
+	}
+
+	fprintf(stderr, "pass statistics: %u function%s in %u file%s, %.3f ms\n",
+		fns_nr, fns_nr == 1 ? "" : "s",
+		files_nr, files_nr == 1 ? "" : "s", msecs(nsecs));
+	fprintf(stderr, "  %-12s %8s %10s %10s %10s %8s %8s\n",
+		"pass", "calls", "ms", "insns in", "insns out", "bbs in", "bbs out");
+	for (j = 0; j < PASS_NR; j++) {
+		const struct pass_stat *stat = total + j;
+
+		if (!stat->calls)
+			continue;
+		fprintf(stderr, "  %-12s %8lu %10.3f %10lu %10lu %8lu %8lu\n",
+			pass_names[j], stat->calls, msecs(stat->nsecs),
+			stat->insns_in, stat->insns_out, stat->bbs_in, stat->bbs_out);
+	}
+}
+
+static void show_files(void)
+{
+	unsigned int i;
+
+	if (files_nr < 2)
+		return;
+	fprintf(stderr, "per file:\n");
+	for (i = 0; i < files_nr; i++) {
+		const struct file_stats *file = files + i;
+
+		fprintf(stderr, "  %10.3f ms  %s: %lu functions\n",
+			msecs(file->nsecs), file->name, file->functions);
+	}
+}
+
+static void show_slowest(struct fn_stats **sorted)
+{
+	int i, nr = fns_nr;
+
+	if (pass_stats_top < nr)
+		nr = pass_stats_top;
+	if (nr <= 0)
+		return;
+	fprintf(stderr, "slowest functions:\n");
+	for (i = 0; i < nr; i++) {
+		const struct fn_stats *fn = sorted[i];
+
+		fprintf(stderr, "  %10.3f ms  %s:%d %s: %lu -> %lu insns, %lu -> %lu bbs\n",
+			msecs(fn->nsecs), stream_name(fn->sym->pos.stream),
+			fn->sym->pos.line, fn_name(fn),
+			fn->insns, fn->insns_out, fn->bbs, fn->bbs_out);
+	}
+}
+
+static void json_string(FILE *f, const char *s)
+{
+	putc('"', f);
+	for (; *s; s++) {
+		unsigned char c = *s;
+
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < ' ')
+			fprintf(f, "\\u%04x", c);
+		else
+			putc(c, f);
+	}
+	putc('"', f);
+}
+
+static void json_passes(FILE *f, const struct pass_stat *pass, const char *indent)
+{
+	int i, first = 1;
+
+	fprintf(f, "{");
+	for (i = 0; i < PASS_NR; i++) {
+		const struct pass_stat *stat = pass + i;
+
+		if (!stat->calls)
+			continue;
+		fprintf(f, "%s\n%s  \"%s\": { \"calls\": %lu, \"ms\": %.6f, "
+			"\"insns_in\": %lu, \"insns_out\": %lu, "
+			"\"bbs_in\": %lu, \"bbs_out\": %lu }",
+			first ? "" : ",", indent, pass_names[i], stat->calls,
+			msecs(stat->nsecs), stat->insns_in, stat->insns_out,
+			stat->bbs_in, stat->bbs_out);
+		first = 0;
+	}
+	fprintf(f, "\n%s}", indent);
+}
+
+static void dump_json(struct fn_stats **sorted)
+{
+	FILE *f = stdout;
+	unsigned int i;
+
+	if (strcmp(pass_stats_json, "-")) {
+		f = fopen(pass_stats_json, "w");
+		if (!f) {
+			fprintf(stderr, "unable to open '%s' for pass statistics\n", pass_stats_json);
+			return;
+		}
+	}
+
+	fprintf(f, "{\n  \"files\": [");
+	for (i = 0; i < files_nr; i++) {
+		const struct file_stats *file = files + i;
+
+		fprintf(f, "%s\n    { \"name\": ", i ? "," : "");
+		json_string(f, file->name);
+		fprintf(f, ", \"functions\": %lu, \"ms\": %.6f,\n      \"passes\": ",
+			file->functions, msecs(file->nsecs));
+		json_passes(f, file->pass, "      ");
+		fprintf(f, " }");
+	}
+	fprintf(f, "\n  ],\n  \"functions\": [");
+
+	/* Slowest first, like the report */
+	for (i = 0; i < fns_nr; i++) {
+		const struct fn_stats *fn = sorted[i];
+
+		fprintf(f, "%s\n    { \"name\": ", i ? "," : "");
+		json_string(f, fn_name(fn));
+		fprintf(f, ", \"file\": ");
+		json_string(f, stream_name(fn->sym->pos.stream));
+		fprintf(f, ", \"line\": %d, \"unit\": ", fn->sym->pos.line);
+		json_string(f, files[fn->file].name);
+		fprintf(f, ", \"ms\": %.6f,\n      \"insns\": %lu, \"insns_out\": %lu, "
+			"\"bbs\": %lu, \"bbs_out\": %lu,\n      \"passes\": ",
+			msecs(fn->nsecs), fn->insns, fn->insns_out, fn->bbs, fn->bbs_out);
+		json_passes(f, fn->pass, "      ");
+		fprintf(f, " }");
+	}
+	fprintf(f, "\n  ]\n}\n");
+
+	if (f != stdout)
+		fclose(f);
+}
+
+void show_pass_stats(void)
+{
+	struct fn_stats **sorted;
+	unsigned int i;
+
+	sorted = malloc((fns_nr + 1) * sizeof(*sorted));
+	if (!sorted)
+		return;
+	for (i = 0; i < fns_nr; i++)
+		sorted[i] = fns + i;
+	qsort(sorted, fns_nr, sizeof(*sorted), slower_fn);
+
+	show_pass_table();
+	show_files();
+	show_slowest(sorted);
+	if (pass_stats_json)
+		dump_json(sorted);
+	free(sorted);
+}
@@ -9,6 +9,7 @@
 #include <string.h>
 #include <assert.h>
 
+#include "lib.h"
 #include "ptrlist.h"
 #include "allocate.h"
 #include "compat.h"
@@ -16,17 +17,35 @@
 __DECLARE_ALLOCATOR(struct ptr_list, ptrlist);
 __ALLOCATOR(struct ptr_list, "ptr list", ptrlist);
 
-int ptr_list_size(struct ptr_list *head)
+/*
+ * Return entry 'idx' (counting from zero) of the list, or NULL
+ * if the list is shorter than that. The head keeps the total
+ * count, so we can skip whole nodes at a time and start from
+ * whichever end of the list is closer.
+ */
+void *ptr_list_nth_entry(struct ptr_list *head, unsigned int idx)
 {
-	int nr = 0;
+	struct ptr_list *list;
 
-	if (head) {
-		struct ptr_list *list = head;
-		do {
-			nr += list->nr;
-		} while ((list = list->next) != head);
+	if (!head || idx >= head->total)
+		return NULL;
+
+	if (idx < head->total / 2) {
+		list = head;
+		while (idx >= list->nr) {
+			idx -= list->nr;
+			list = list->next;
+		}
+	} else {
+		idx = head->total - 1 - idx;
+		list = head->prev;
+		while (idx >= list->nr) {
+			idx -= list->nr;
+			list = list->prev;
+		}
+		idx = list->nr - 1 - idx;
 	}
-	return nr;
+	return PTR_ENTRY(list, idx);
 }
 
 /*
@@ -70,6 +89,7 @@ void pack_ptr_list(struct ptr_list **listp)
 
 	if (head) {
 		struct ptr_list *entry = head;
+		int total = head->total;
 		do {
 			struct ptr_list *next;
 restart:
@@ -88,6 +108,7 @@ restart:
 				if (entry == head) {
 					*listp = next;
 					head = next;
+					head->total = total;
 					entry = next;
 					goto restart;
 				}
@@ -145,6 +166,7 @@ void **__add_ptr_list(struct ptr_list **listp, void *ptr, unsigned long tag)
 	*ret = ptr;
 	nr++;
 	last->nr = nr;
+	(*listp)->total++;
 	return ret;
 }
 
@@ -196,6 +218,7 @@ void * undo_ptr_list_last(struct ptr_list **head)
 			int nr = --last->nr;
 			ptr = last->list[nr];
 			last->list[nr] = (void *)0xf1f1f1f1;
+			first->total--;
 			return ptr;
 		}
 	} while (last != first);
@@ -210,8 +233,10 @@ void * delete_ptr_list_last(struct ptr_list **head)
 	if (!first)
 		return NULL;
 	last = first->prev;
-	if (last->nr)
+	if (last->nr) {
 		ptr = last->list[--last->nr];
+		first->total--;
+	}
 	if (last->nr <=0) {
 		first->prev = last->prev;
 		last->prev->next = first;
@@ -246,3 +271,29 @@ void __free_ptr_list(struct ptr_list **listp)
 
 	*listp = NULL;
 }
+
+void **__add_ptr_vec(struct ptr_vec *vec, void *ptr)
+{
+	void **ret;
+	int nr = vec->nr;
+
+	if (nr >= vec->alloc) {
+		int newalloc = nr ? nr * 2 : LIST_NODE_NR;
+		vec->list = realloc(vec->list, newalloc * sizeof(void *));
+		if (!vec->list)
+			die("Unable to allocate more pointer vector space");
+		vec->alloc = newalloc;
+	}
+	ret = vec->list + nr;
+	*ret = ptr;
+	vec->nr = nr + 1;
+	return ret;
+}
+
+void __free_ptr_vec(struct ptr_vec *vec)
+{
+	free(vec->list);
+	vec->list = NULL;
+	vec->nr = 0;
+	vec->alloc = 0;
+}
@@ -22,10 +22,18 @@
  */
 #define MKTYPE(head,expr)		({ (TYPEOF(head))(expr); })
 
+/*
+ * 29 entries make a node exactly four 64-byte cache lines on
+ * LP64. Override with -DLIST_NODE_NR=... to experiment with
+ * other node sizes.
+ */
+#ifndef LIST_NODE_NR
 #define LIST_NODE_NR (29)
+#endif
 
 struct ptr_list {
 	int nr;
+	int total;		/* entries in the whole list, valid in the head node only */
 	struct ptr_list *prev;
 	struct ptr_list *next;
 	void *list[LIST_NODE_NR];
@@ -42,8 +50,8 @@ extern void sort_list(struct ptr_list **, int (*)(const void *, const void *));
 extern void **__add_ptr_list(struct ptr_list **, void *, unsigned long);
 extern void concat_ptr_list(struct ptr_list *a, struct ptr_list **b);
 extern void __free_ptr_list(struct ptr_list **);
-extern int ptr_list_size(struct ptr_list *);
 extern int linearize_ptr_list(struct ptr_list *, void **, int);
+extern void *ptr_list_nth_entry(struct ptr_list *, unsigned int);
 
 /*
  * Hey, who said that you can't do overloading in C?
@@ -65,6 +73,11 @@ extern int linearize_ptr_list(struct ptr_list *, void **, int);
 #define PTR_ENTRY_NOTAG(h,i)	((h)->list[i])
 #define PTR_ENTRY(h,i)	(void *)(~3UL & (unsigned long)PTR_ENTRY_NOTAG(h,i))
 
+static inline int ptr_list_size(struct ptr_list *head)
+{
+	return head ? head->total : 0;
+}
+
 static inline void *first_ptr_list(struct ptr_list *list)
 {
 	if (!list)
@@ -239,6 +252,7 @@ extern void split_ptr_list_head(struct ptr_list *);
 	}										\
 	*__this = (new);								\
 	__list->nr++;									\
+	__head->total++;								\
 } while (0)
 
 #define INSERT_CURRENT(new, ptr) \
@@ -253,6 +267,7 @@ extern void split_ptr_list_head(struct ptr_list *);
 	}										\
 	*__this = (void *)0xf0f0f0f0;							\
 	__list->nr--; __nr--;								\
+	__head->total--;								\
 } while (0)
 
 #define DELETE_CURRENT_PTR(ptr) \
@@ -279,4 +294,89 @@ static inline void *tag_ptr(void *ptr, unsigned long tag)
 #define CURRENT_TAG(ptr) (3 & (unsigned long)*THIS_ADDRESS(ptr))
 #define TAG_CURRENT(ptr,val)	update_tag(THIS_ADDRESS(ptr),val)
 
+/*
+ * Vector-backed pointer lists.
+ *
+ * One contiguous array with amortized growth, for hot lists that
+ * are mostly appended to and scanned linearly. The size is O(1),
+ * walking it never chases a node pointer, and entries are never
+ * tagged so there is nothing to mask on the way out.
+ *
+ * A vector lives by value (usually embedded in some other struct
+ * or in a static array); an all-zero vector is a valid empty one.
+ */
+#define DECLARE_PTR_VEC(vecname,type)	struct vecname { int nr, alloc; type **list; }
+
+struct ptr_vec {
+	int nr, alloc;
+	void **list;
+};
+
+extern void **__add_ptr_vec(struct ptr_vec *, void *);
+extern void __free_ptr_vec(struct ptr_vec *);
+extern void sort_vec(struct ptr_vec *, int (*)(const void *, const void *));
+
+#define add_ptr_vec(vec,entry) \
+	MKTYPE(vec, (CHECK_TYPE(vec,(entry)),__add_ptr_vec((struct ptr_vec *)(vec), (entry))))
+#define free_ptr_vec(vec) \
+	do { VRFY_PTR_LIST(vec); __free_ptr_vec((struct ptr_vec *)(vec)); } while (0)
+#define ptr_vec_size(vec)		((vec)->nr)
+#define reset_ptr_vec(vec)		do { (vec)->nr = 0; } while (0)
+#define pop_ptr_vec(vec)		((vec)->list[--(vec)->nr])
+#define SORT_PTR_VEC(vec,cmp)		sort_vec((struct ptr_vec *)(vec), cmp)
+
+#define DO_FOR_EACH_VEC(vec, ptr, __vec, __nr) do {					\
+	struct ptr_vec *__vec = (struct ptr_vec *) (vec);				\
+	int __nr;									\
+	CHECK_TYPE(vec,ptr);								\
+	for (__nr = 0; __nr < __vec->nr; __nr++) {					\
+		do {									\
+			ptr = __vec->list[__nr];					\
+			do {
+
+#define DO_END_FOR_EACH_VEC(ptr, __vec, __nr)						\
+			} while (0);							\
+		} while (0);								\
+	}										\
+} while (0)
+
+#define DO_FOR_EACH_VEC_REVERSE(vec, ptr, __vec, __nr) do {				\
+	struct ptr_vec *__vec = (struct ptr_vec *) (vec);				\
+	int __nr;									\
+	CHECK_TYPE(vec,ptr);								\
+	for (__nr = __vec->nr; --__nr >= 0; ) {						\
+		do {									\
+			ptr = __vec->list[__nr];					\
+			do {
+
+#define DO_DELETE_CURRENT_VEC(ptr, __vec, __nr) do {					\
+	void **__this = __vec->list + __nr;						\
+	void **__last = __vec->list + __vec->nr - 1;					\
+	while (__this < __last) {							\
+		__this[0] = __this[1];							\
+		__this++;								\
+	}										\
+	__vec->nr--; __nr--;								\
+} while (0)
+
+#define FOR_EACH_VEC(vec, ptr) \
+	DO_FOR_EACH_VEC(vec, ptr, __vec##ptr, __nr##ptr)
+
+#define END_FOR_EACH_VEC(ptr) \
+	DO_END_FOR_EACH_VEC(ptr, __vec##ptr, __nr##ptr)
+
+#define FOR_EACH_VEC_REVERSE(vec, ptr) \
+	DO_FOR_EACH_VEC_REVERSE(vec, ptr, __vec##ptr, __nr##ptr)
+
+#define END_FOR_EACH_VEC_REVERSE(ptr) END_FOR_EACH_VEC(ptr)
+
+#define THIS_VEC_ADDRESS(ptr) \
+	((__typeof__(&(ptr))) (__vec##ptr->list + __nr##ptr))
+
+#define REPLACE_CURRENT_VEC(ptr, new_ptr) \
+	do { *THIS_VEC_ADDRESS(ptr) = (new_ptr); } while (0)
+
+#define DELETE_CURRENT_VEC(ptr) \
+	DO_DELETE_CURRENT_VEC(ptr, __vec##ptr, __nr##ptr)
+
 #endif /* PTR_LIST_H */
@@ -0,0 +1,364 @@
+/*
+ * Sparse conditional constant propagation.
+ *
+ * Wegman & Zadeck: every pseudo starts out unknown ("top"), and is
+ * lowered to a constant or to "bottom" (not a constant) as the
+ * instructions defining it are found to be executable. Blocks only
+ * become executable through the edges of executable branches whose
+ * condition allows them, so constants flow around the code that
+ * can't be reached, and through the phi-nodes of loops.
+ *
+ * At the end the constant pseudos are replaced by their value, the
+ * branches on them are made unconditional, and whatever can't be
+ * reached anymore is thrown away.
+ *
+ * The lattice value lives in pseudo->priv while we work:
+ *	NULL		unknown
+ *	PSEUDO_VAL	that constant (value pseudos are unique)
+ *	&sccp_bottom	not a constant
+ */
+
+#include <stdlib.h>
+
+#include "lib.h"
+#include "linearize.h"
+#include "flow.h"
+
+static struct pseudo sccp_bottom;
+#define BOTTOM	(&sccp_bottom)
+
+static unsigned long sccp_generation;
+static struct basic_block_vec sccp_blocks;
+static struct instruction_vec sccp_insns;
+static struct pseudo_vec sccp_touched;
+
+static inline int executable(struct basic_block *bb)
+{
+	return bb && bb->generation == sccp_generation;
+}
+
+static pseudo_t sccp_value(pseudo_t pseudo)
+{
+	switch (pseudo->type) {
+	case PSEUDO_VAL:
+		return pseudo;
+	case PSEUDO_REG:
+	case PSEUDO_PHI:
+		if (!pseudo->def || !pseudo->def->bb)
+			return BOTTOM;
+		return pseudo->priv;
+	default:
+		return BOTTOM;
+	}
+}
+
+static void mark_executable(struct basic_block *bb)
+{
+	if (!bb || bb->generation == sccp_generation)
+		return;
+	bb->generation = sccp_generation;
+	add_ptr_vec(&sccp_blocks, bb);
+}
+
+/*
+ * Lower the value of "pseudo" to "val", and revisit
+ * its users if it changed.
+ */
+static void lower_value(pseudo_t pseudo, pseudo_t val)
+{
+	pseudo_t old = pseudo->priv;
+	struct pseudo_user *pu;
+
+	if (!val || old == val || old == BOTTOM)
+		return;
+	if (old)
+		val = BOTTOM;
+	else
+		add_ptr_vec(&sccp_touched, pseudo);
+	pseudo->priv = val;
+
+	FOR_EACH_PTR(pseudo->users, pu) {
+		struct instruction *insn = pu->insn;
+		if (executable(insn->bb))
+			add_ptr_vec(&sccp_insns, insn);
+	} END_FOR_EACH_PTR(pu);
+}
+
+static pseudo_t meet(pseudo_t a, pseudo_t b)
+{
+	if (!a)
+		return b;
+	if (!b || a == b)
+		return a;
+	return BOTTOM;
+}
+
+static pseudo_t eval_phi(struct instruction *insn)
+{
+	pseudo_t phi, val = NULL;
+
+	FOR_EACH_PTR(insn->phi_list, phi) {
+		if (phi == VOID || !phi->def->bb)
+			continue;
+		val = meet(val, sccp_value(phi));
+		if (val == BOTTOM)
+			break;
+	} END_FOR_EACH_PTR(phi);
+	return val;
+}
+
+static pseudo_t eval_constant(struct instruction *insn)
+{
+	pseudo_t src1, src2;
+	long long res;
+
+	switch (insn->opcode) {
+	case OP_BINARY ... OP_BINARY_END:
+	case OP_BINCMP ... OP_BINCMP_END:
+		src1 = sccp_value(insn->src1);
+		src2 = sccp_value(insn->src2);
+		if (src1 == BOTTOM || src2 == BOTTOM)
+			return BOTTOM;
+		if (!src1 || !src2)
+			return NULL;
+		if (!eval_binop(insn, src1->value, src2->value, &res))
+			return BOTTOM;
+		return value_pseudo(res);
+
+	case OP_NOT: case OP_NEG:
+		src1 = sccp_value(insn->src1);
+		if (!src1 || src1 == BOTTOM)
+			return src1;
+		if (!eval_unop(insn, src1->value, &res))
+			return BOTTOM;
+		return value_pseudo(res);
+
+	case OP_CAST: case OP_SCAST:
+		src1 = sccp_value(insn->src);
+		if (!src1 || src1 == BOTTOM)
+			return src1;
+		if (!eval_cast(insn, src1->value, &res))
+			return BOTTOM;
+		return value_pseudo(res);
+
+	case OP_SEL:
+		src1 = sccp_value(insn->src1);
+		if (!src1)
+			return NULL;
+		if (src1 != BOTTOM)
+			return sccp_value(src1->value ? insn->src2 : insn->src3);
+		return meet(sccp_value(insn->src2), sccp_value(insn->src3));
+
+	case OP_PHI:
+		return eval_phi(insn);
+
+	default:
+		return BOTTOM;
+	}
+}
+
+static struct multijmp *switch_target(struct instruction *insn, long long val)
+{
+	struct multijmp *jmp;
+
+	FOR_EACH_PTR(insn->multijmp_list, jmp) {
+		/* Default case */
+		if (jmp->begin > jmp->end)
+			return jmp;
+		if (val >= jmp->begin && val <= jmp->end)
+			return jmp;
+	} END_FOR_EACH_PTR(jmp);
+	return NULL;
+}
+
+static void eval_terminator(struct instruction *insn)
+{
+	struct basic_block *bb = insn->bb, *child;
+	struct multijmp *jmp;
+	pseudo_t cond;
+
+	switch (insn->opcode) {
+	case OP_BR:
+		if (!insn->cond) {
+			mark_executable(insn->bb_true);
+			return;
+		}
+		cond = sccp_value(insn->cond);
+		if (!cond)
+			return;
+		if (cond != BOTTOM) {
+			mark_executable(cond->value ? insn->bb_true : insn->bb_false);
+			return;
+		}
+		mark_executable(insn->bb_true);
+		mark_executable(insn->bb_false);
+		return;
+
+	case OP_SWITCH:
+		cond = sccp_value(insn->cond);
+		if (!cond)
+			return;
+		if (cond != BOTTOM) {
+			jmp = switch_target(insn, cond->value);
+			if (jmp) {
+				mark_executable(jmp->target);
+				return;
+			}
+		}
+		FOR_EACH_PTR(insn->multijmp_list, jmp) {
+			mark_executable(jmp->target);
+		} END_FOR_EACH_PTR(jmp);
+		return;
+
+	default:
+		FOR_EACH_PTR(bb->children, child) {
+			mark_executable(child);
+		} END_FOR_EACH_PTR(child);
+		return;
+	}
+}
+
+static void eval_instruction(struct instruction *insn)
+{
+	pseudo_t target = insn->target;
+	struct asm_constraint *out;
+
+	switch (insn->opcode) {
+	case OP_TERMINATOR ... OP_TERMINATOR_END:
+		eval_terminator(insn);
+		return;
+	case OP_PHISOURCE:
+		lower_value(target, sccp_value(insn->phi_src));
+		return;
+	case OP_ASM:
+		FOR_EACH_PTR(insn->asm_rules->outputs, out) {
+			if (out->pseudo->type == PSEUDO_REG)
+				lower_value(out->pseudo, BOTTOM);
+		} END_FOR_EACH_PTR(out);
+		return;
+	}
+
+	if (!target || target->type != PSEUDO_REG || target->def != insn)
+		return;
+	lower_value(target, eval_constant(insn));
+}
+
+static void sccp_propagate(void)
+{
+	while (ptr_vec_size(&sccp_blocks) || ptr_vec_size(&sccp_insns)) {
+		struct instruction *insn;
+
+		while (ptr_vec_size(&sccp_blocks)) {
+			struct basic_block *bb = pop_ptr_vec(&sccp_blocks);
+			FOR_EACH_PTR(bb->insns, insn) {
+				if (insn->bb)
+					eval_instruction(insn);
+			} END_FOR_EACH_PTR(insn);
+		}
+		while (ptr_vec_size(&sccp_insns)) {
+			insn = pop_ptr_vec(&sccp_insns);
+			if (executable(insn->bb))
+				eval_instruction(insn);
+		}
+	}
+}
+
+/*
+ * A branch on a value that is still unknown would leave its targets
+ * unexplored: assume it can go anywhere, and carry on.
+ */
+static int resolve_unknown_branches(struct entrypoint *ep)
+{
+	struct basic_block *bb;
+	int changed = 0;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *br;
+
+		if (!executable(bb))
+			continue;
+		br = last_instruction(bb->insns);
+		if (!br || (br->opcode != OP_BR && br->opcode != OP_SWITCH) || !br->cond)
+			continue;
+		if (sccp_value(br->cond))
+			continue;
+		lower_value(br->cond, BOTTOM);
+		changed = 1;
+	} END_FOR_EACH_PTR(bb);
+	return changed;
+}
+
+static int rewrite_branch_on_constant(struct basic_block *bb)
+{
+	struct instruction *br = last_instruction(bb->insns);
+	struct multijmp *jmp;
+	pseudo_t cond;
+
+	if (!br || !br->bb || !br->cond)
+		return 0;
+	cond = br->cond;
+	if (cond->type != PSEUDO_VAL)
+		return 0;
+
+	switch (br->opcode) {
+	case OP_BR:
+		insert_branch(bb, br, cond->value ? br->bb_true : br->bb_false);
+		return 1;
+	case OP_SWITCH:
+		jmp = switch_target(br, cond->value);
+		if (!jmp)
+			return 0;
+		insert_branch(bb, br, jmp->target);
+		return 1;
+	}
+	return 0;
+}
+
+void sccp(struct entrypoint *ep)
+{
+	struct basic_block *bb;
+	pseudo_t pseudo;
+	int branches = 0;
+
+	sccp_generation = ++bb_generation;
+	reset_ptr_vec(&sccp_blocks);
+	reset_ptr_vec(&sccp_insns);
+	reset_ptr_vec(&sccp_touched);
+
+	mark_executable(ep->entry->bb);
+	do {
+		sccp_propagate();
+	} while (resolve_unknown_branches(ep));
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *insn;
+
+		if (!executable(bb))
+			continue;
+		FOR_EACH_PTR(bb->insns, insn) {
+			pseudo_t target = insn->target;
+
+			if (!insn->bb || insn->opcode <= OP_TERMINATOR_END)
+				continue;
+			if (!target || target->type != PSEUDO_REG || target->def != insn)
+				continue;
+			pseudo = target->priv;
+			if (!pseudo || pseudo == BOTTOM)
+				continue;
+			convert_instruction_target(insn, pseudo);
+			repeat_phase |= REPEAT_CSE;
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		if (executable(bb))
+			branches += rewrite_branch_on_constant(bb);
+	} END_FOR_EACH_PTR(bb);
+
+	FOR_EACH_VEC(&sccp_touched, pseudo) {
+		pseudo->priv = NULL;
+	} END_FOR_EACH_VEC(pseudo);
+
+	if (branches)
+		kill_unreachable_bbs(ep);
+}
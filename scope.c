@@ -94,8 +94,9 @@ void start_function_scope(void)
 
 static void remove_symbol_scope(struct symbol *sym)
 {
-	struct symbol **ptr = &sym->ident->symbols;
+	struct symbol **ptr = ident_symbols(sym->ident, sym->namespace);
 
+	/* Nearly always the first one: scopes end innermost first */
 	while (*ptr != sym)
 		ptr = &(*ptr)->next_id;
 	*ptr = sym->next_id;
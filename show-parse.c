@@ -368,7 +368,7 @@ deeper:
 			append(name, " )");
 			was_ptr = 0;
 		}
-		append(name, "[%lld]", get_expression_value(sym->array_size));
+		append(name, "[%lld]", get_expression_value(cold_field(sym, array_size)));
 		break;
 
 	case SYM_RESTRICT:
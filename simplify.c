@@ -32,6 +32,8 @@ static void clear_phi(struct instruction *insn)
 
 	insn->bb = NULL;
 	FOR_EACH_PTR(insn->phi_list, phi) {
+		if (cse_tracking && phi != VOID)
+			cse_queue_insn(phi->def);
 		*THIS_ADDRESS(phi) = VOID;
 	} END_FOR_EACH_PTR(phi);
 }
@@ -170,6 +172,8 @@ static inline void remove_usage(pseudo_t p, pseudo_t *usep)
 		delete_pseudo_user_list_entry(&p->users, usep, 1);
 		if (!p->users)
 			kill_instruction(p->def);
+		else if (cse_tracking && (p->type == PSEUDO_REG || p->type == PSEUDO_PHI))
+			cse_queue_insn(p->def);
 	}
 }
 
@@ -367,11 +371,13 @@ static int simplify_constant_leftside(struct instruction *insn)
 	return 0;
 }
 
-static int simplify_constant_binop(struct instruction *insn)
+/*
+ * Evaluate the binop or compare "insn" on two constant operands.
+ * Return 0 if the result is not known (division by zero, ..).
+ */
+int eval_binop(struct instruction *insn, long long left, long long right, long long *val)
 {
 	/* FIXME! Verify signs and sizes!! */
-	long long left = insn->src1->value;
-	long long right = insn->src2->value;
 	unsigned long long ul, ur;
 	long long res, mask, bits;
 
@@ -482,8 +488,16 @@ static int simplify_constant_binop(struct instruction *insn)
 	default:
 		return 0;
 	}
-	res &= bits;
+	*val = res & bits;
+	return 1;
+}
+
+static int simplify_constant_binop(struct instruction *insn)
+{
+	long long res;
 
+	if (!eval_binop(insn, insn->src1->value, insn->src2->value, &res))
+		return 0;
 	replace_with_pseudo(insn, value_pseudo(res));
 	return REPEAT_CSE;
 }
@@ -560,24 +574,31 @@ static int simplify_associative_binop(struct instruction *insn)
 	return REPEAT_CSE;
 }
 
-static int simplify_constant_unop(struct instruction *insn)
+int eval_unop(struct instruction *insn, long long val, long long *res)
 {
-	long long val = insn->src1->value;
-	long long res, mask;
+	long long mask;
 
 	switch (insn->opcode) {
 	case OP_NOT:
-		res = ~val;
+		*res = ~val;
 		break;
 	case OP_NEG:
-		res = -val;
+		*res = -val;
 		break;
 	default:
 		return 0;
 	}
 	mask = 1ULL << (insn->size-1);
-	res &= mask | (mask-1);
-	
+	*res &= mask | (mask-1);
+	return 1;
+}
+
+static int simplify_constant_unop(struct instruction *insn)
+{
+	long long res;
+
+	if (!eval_unop(insn, insn->src1->value, &res))
+		return 0;
 	replace_with_pseudo(insn, value_pseudo(res));
 	return REPEAT_CSE;
 }
@@ -660,6 +681,24 @@ static long long get_cast_value(long long val, int old_size, int new_size, int s
 	return val & (mask | (mask-1));
 }
 
+/*
+ * Evaluate the cast "insn" of the constant "val", if it's
+ * a cast between non-pointer types.
+ */
+int eval_cast(struct instruction *insn, long long val, long long *res)
+{
+	struct symbol *orig_type = insn->orig_type;
+	int sign;
+
+	if (!orig_type)
+		return 0;
+	if (is_ptr_type(orig_type) || is_ptr_type(insn->type))
+		return 0;
+	sign = orig_type->ctype.modifiers & MOD_SIGNED;
+	*res = get_cast_value(val, orig_type->bit_size, insn->size, sign);
+	return 1;
+}
+
 static int simplify_cast(struct instruction *insn)
 {
 	struct symbol *orig_type;
@@ -7,11 +7,18 @@
  * Space complexity: O(1).
  *
  * Stable: yes.
+ *
+ * Big lists (and vectors) are cut into one chunk per thread, the
+ * chunks get sorted concurrently and are then merged pairwise, again
+ * concurrently.  A stable sort has exactly one possible result, so
+ * the output doesn't depend on the number of threads.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "lib.h"
 #include "allocate.h"
@@ -38,7 +45,7 @@ static unsigned char been_there[256];
 #define BEEN_THERE(_c) do { } while (0)
 #endif
 
-// Sort one fragment.  LIST_NODE_NR (==29) is a bit too high for my
+// Sort one fragment.  LIST_NODE_NR (29 by default) is a bit too high for my
 // taste for something this simple.  But, hey, it's O(1).
 //
 // I would use libc qsort for this, but its comparison function
@@ -222,13 +229,14 @@ merge_block_seqs (struct ptr_list *b1, int n,
 }
 
 
-void sort_list(struct ptr_list **plist, int (*cmp)(const void *, const void *))
+static void __sort_list(struct ptr_list **plist, int (*cmp)(const void *, const void *))
 {
 	struct ptr_list *head = *plist, *list = head;
-	int blocks = 1;
+	int blocks = 1, total;
 
 	if (!head)
 		return;
+	total = head->total;
 
 	// Sort all the sub-lists
 	do {
@@ -253,6 +261,7 @@ void sort_list(struct ptr_list **plist, int (*cmp)(const void *, const void *))
 				if (block2 == head) {
 					if (block1 == head) {
 						BEEN_THERE('A');
+						head->total = total;
 						*plist = head;
 						return;
 					}
@@ -288,3 +297,287 @@ void sort_list(struct ptr_list **plist, int (*cmp)(const void *, const void *))
 		blocks <<= 1;
 	}
 }
+
+// Sort jobs get handed out round-robin to a handful of threads; the
+// calling thread takes its share too.  If we can't start a thread we
+// just do its jobs ourselves.
+#define MAX_SORT_THREADS	16
+#define SORT_PARALLEL_MIN	(32 * 1024)
+
+struct sort_worker {
+	pthread_t thread;
+	void (*fn)(void *);
+	char *jobs;
+	size_t size;
+	int first, step, nr;
+};
+
+static void *sort_worker(void *arg)
+{
+	struct sort_worker *w = arg;
+	int i;
+
+	for (i = w->first; i < w->nr; i += w->step)
+		w->fn(w->jobs + i * w->size);
+	return NULL;
+}
+
+static int nr_sort_threads(void)
+{
+	long nr = sort_threads;
+
+	if (nr <= 0) {
+		nr = sysconf(_SC_NPROCESSORS_ONLN);
+		if (nr > 8)
+			nr = 8;
+	}
+	if (nr < 1)
+		nr = 1;
+	if (nr > MAX_SORT_THREADS)
+		nr = MAX_SORT_THREADS;
+	return nr;
+}
+
+static void run_sort_jobs(void *jobs, size_t size, int nr, void (*fn)(void *))
+{
+	struct sort_worker workers[MAX_SORT_THREADS];
+	int threads = nr_sort_threads(), started[MAX_SORT_THREADS];
+	int i;
+
+	if (threads > nr)
+		threads = nr;
+	for (i = 0; i < threads; i++) {
+		struct sort_worker *w = workers + i;
+		w->fn = fn;
+		w->jobs = jobs;
+		w->size = size;
+		w->first = i;
+		w->step = threads;
+		w->nr = nr;
+		started[i] = i && !pthread_create(&w->thread, NULL, sort_worker, w);
+	}
+	for (i = 0; i < threads; i++) {
+		if (!started[i])
+			sort_worker(workers + i);
+	}
+	for (i = 1; i < threads; i++) {
+		if (started[i])
+			pthread_join(workers[i].thread, NULL);
+	}
+}
+
+struct list_sort_job {
+	struct ptr_list *head;
+	int blocks;
+	struct list_sort_job *other;
+	int (*cmp)(const void *, const void *);
+};
+
+static void sort_chunk_job(void *arg)
+{
+	struct list_sort_job *job = arg;
+	__sort_list(&job->head, job->cmp);
+}
+
+static void merge_chunk_job(void *arg)
+{
+	struct list_sort_job *job = arg, *other = job->other;
+	job->head = merge_block_seqs(job->head, job->blocks,
+				     other->head, other->blocks, job->cmp);
+	job->blocks += other->blocks;
+}
+
+// Close 'first' ... 'last' into a list of their own.
+static void cut_chunk(struct ptr_list *first, struct ptr_list *last)
+{
+	first->prev = last;
+	last->next = first;
+}
+
+// Append the (circular) list 'b' to the (circular) list 'a'.
+static void join_chunks(struct ptr_list *a, struct ptr_list *b)
+{
+	struct ptr_list *a_last = a->prev, *b_last = b->prev;
+
+	a_last->next = b;
+	b->prev = a_last;
+	b_last->next = a;
+	a->prev = b_last;
+}
+
+static void parallel_sort_list(struct ptr_list **plist, int (*cmp)(const void *, const void *))
+{
+	struct list_sort_job jobs[MAX_SORT_THREADS], merges[MAX_SORT_THREADS / 2];
+	struct ptr_list *head = *plist, *list = head;
+	int total = head->total, blocks = 0, chunks, i;
+
+	do {
+		blocks++;
+		list = list->next;
+	} while (list != head);
+
+	chunks = nr_sort_threads();
+	if (chunks > blocks)
+		chunks = blocks;
+
+	// Cut the list into 'chunks' lists of consecutive blocks
+	for (i = 0; i < chunks; i++) {
+		int n = blocks / chunks + (i < blocks % chunks);
+		struct ptr_list *first = list, *last;
+
+		while (--n)
+			list = list->next;
+		last = list;
+		list = list->next;
+		jobs[i].head = first;
+		jobs[i].blocks = blocks / chunks + (i < blocks % chunks);
+		jobs[i].cmp = cmp;
+		cut_chunk(first, last);
+	}
+	run_sort_jobs(jobs, sizeof(jobs[0]), chunks, sort_chunk_job);
+
+	// .. and merge them back together, pairwise
+	while (chunks > 1) {
+		int pairs = chunks / 2;
+
+		for (i = 0; i < pairs; i++) {
+			merges[i] = jobs[2*i];
+			merges[i].other = &jobs[2*i+1];
+			join_chunks(merges[i].head, jobs[2*i+1].head);
+		}
+		run_sort_jobs(merges, sizeof(merges[0]), pairs, merge_chunk_job);
+		for (i = 0; i < pairs; i++)
+			jobs[i] = merges[i];
+		if (chunks & 1)
+			jobs[pairs] = jobs[chunks - 1];
+		chunks = pairs + (chunks & 1);
+	}
+
+	head = jobs[0].head;
+	head->total = total;
+	*plist = head;
+}
+
+void sort_list(struct ptr_list **plist, int (*cmp)(const void *, const void *))
+{
+	struct ptr_list *head = *plist;
+
+	if (!head)
+		return;
+	if (head->total >= SORT_PARALLEL_MIN && nr_sort_threads() > 1) {
+		parallel_sort_list(plist, cmp);
+		return;
+	}
+	__sort_list(plist, cmp);
+}
+
+static void merge_runs(void **src, void **dst, int lo, int mid, int hi,
+		       int (*cmp)(const void *, const void *))
+{
+	int i1 = lo, i2 = mid, k = lo;
+
+	while (i1 < mid && i2 < hi) {
+		if (cmp(src[i1], src[i2]) <= 0)
+			dst[k++] = src[i1++];
+		else
+			dst[k++] = src[i2++];
+	}
+	while (i1 < mid)
+		dst[k++] = src[i1++];
+	while (i2 < hi)
+		dst[k++] = src[i2++];
+}
+
+// Vectors have no blocks to shuffle around, so this is a plain
+// bottom-up merge sort: insertion-sort runs of LIST_NODE_NR entries
+// (just like the list blocks above), then merge runs of doubling
+// width through a scratch array.  Stable, like sort_list().
+//
+// Sort 'ptr[0..nr)', using 'tmp[0..nr)' as scratch space.
+static void array_merge_sort(void **ptr, void **tmp, int nr,
+			     int (*cmp)(const void *, const void *))
+{
+	void **src = ptr, **dst = tmp;
+	int width, i;
+
+	for (i = 0; i < nr; i += LIST_NODE_NR)
+		array_sort(ptr + i, nr - i < LIST_NODE_NR ? nr - i : LIST_NODE_NR, cmp);
+
+	for (width = LIST_NODE_NR; width < nr; width <<= 1) {
+		void **swap;
+		for (i = 0; i < nr; i += 2 * width) {
+			int mid = i + width, hi = i + 2 * width;
+			if (mid > nr)
+				mid = nr;
+			if (hi > nr)
+				hi = nr;
+			merge_runs(src, dst, i, mid, hi, cmp);
+		}
+		swap = src; src = dst; dst = swap;
+	}
+	if (src != ptr)
+		memcpy(ptr, src, nr * sizeof(void *));
+}
+
+struct vec_sort_job {
+	void **ptr, **tmp;
+	int lo, mid, hi;
+	int (*cmp)(const void *, const void *);
+};
+
+static void sort_run_job(void *arg)
+{
+	struct vec_sort_job *job = arg;
+	array_merge_sort(job->ptr + job->lo, job->tmp + job->lo, job->hi - job->lo, job->cmp);
+}
+
+static void merge_run_job(void *arg)
+{
+	struct vec_sort_job *job = arg;
+	merge_runs(job->ptr, job->tmp, job->lo, job->mid, job->hi, job->cmp);
+	memcpy(job->ptr + job->lo, job->tmp + job->lo, (job->hi - job->lo) * sizeof(void *));
+}
+
+void sort_vec(struct ptr_vec *vec, int (*cmp)(const void *, const void *))
+{
+	struct vec_sort_job jobs[MAX_SORT_THREADS];
+	void **tmp;
+	int nr = vec->nr, chunks = 1, i;
+
+	if (nr < 2)
+		return;
+	if (nr <= LIST_NODE_NR) {
+		array_sort(vec->list, nr, cmp);
+		return;
+	}
+
+	tmp = malloc(nr * sizeof(void *));
+	if (!tmp)
+		die("out of memory");
+
+	if (nr >= SORT_PARALLEL_MIN)
+		chunks = nr_sort_threads();
+	for (i = 0; i < chunks; i++) {
+		jobs[i].ptr = vec->list;
+		jobs[i].tmp = tmp;
+		jobs[i].lo = (long long)nr * i / chunks;
+		jobs[i].hi = (long long)nr * (i + 1) / chunks;
+		jobs[i].cmp = cmp;
+	}
+	run_sort_jobs(jobs, sizeof(jobs[0]), chunks, sort_run_job);
+
+	while (chunks > 1) {
+		int pairs = chunks / 2;
+
+		for (i = 0; i < pairs; i++) {
+			jobs[i] = jobs[2*i];
+			jobs[i].mid = jobs[2*i+1].lo;
+			jobs[i].hi = jobs[2*i+1].hi;
+		}
+		run_sort_jobs(jobs, sizeof(jobs[0]), pairs, merge_run_job);
+		if (chunks & 1)
+			jobs[pairs] = jobs[chunks - 1];
+		chunks = pairs + (chunks & 1);
+	}
+	free(tmp);
+}
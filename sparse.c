@@ -74,43 +74,75 @@ static int imbalance(struct entrypoint *ep, struct basic_block *bb, int entry, i
 	return -1;
 }
 
-static int check_bb_context(struct entrypoint *ep, struct basic_block *bb, int entry, int exit);
-
-static int check_children(struct entrypoint *ep, struct basic_block *bb, int entry, int exit)
-{
-	struct instruction *insn;
-	struct basic_block *child;
+/*
+ * Walk the blocks depth-first, giving each one the context it's entered
+ * with.  A block is only ever looked at once: reaching it again with
+ * the same context is fine, with another one is an imbalance.  The
+ * walk uses its own stack, as large functions can be deeper than we'd
+ * like to recurse.
+ */
+struct context_walk {
+	struct basic_block *bb;
+	int entry;
+};
 
-	insn = last_instruction(bb->insns);
-	if (!insn)
-		return 0;
-	if (insn->opcode == OP_RET)
-		return entry != exit ? imbalance(ep, bb, entry, exit, "wrong count at exit") : 0;
+static struct context_walk *walk_stack;
+static int walk_nr, walk_alloc;
 
-	FOR_EACH_PTR(bb->children, child) {
-		if (check_bb_context(ep, child, entry, exit))
-			return -1;
-	} END_FOR_EACH_PTR(child);
-	return 0;
+static void push_context_walk(struct basic_block *bb, int entry)
+{
+	if (walk_nr == walk_alloc) {
+		walk_alloc = walk_alloc ? walk_alloc * 2 : 64;
+		walk_stack = realloc(walk_stack, walk_alloc * sizeof(*walk_stack));
+		if (!walk_stack)
+			die("out of memory for context walk");
+	}
+	walk_stack[walk_nr].bb = bb;
+	walk_stack[walk_nr].entry = entry;
+	walk_nr++;
 }
 
 static int check_bb_context(struct entrypoint *ep, struct basic_block *bb, int entry, int exit)
 {
-	if (!bb)
-		return 0;
-	if (bb->context == entry)
-		return 0;
+	walk_nr = 0;
+	push_context_walk(bb, entry);
+
+	while (walk_nr) {
+		struct instruction *insn;
+		struct basic_block *child;
+
+		walk_nr--;
+		bb = walk_stack[walk_nr].bb;
+		entry = walk_stack[walk_nr].entry;
+		if (!bb)
+			continue;
+		if (bb->context == entry)
+			continue;
 
-	/* Now that's not good.. */
-	if (bb->context >= 0)
-		return imbalance(ep, bb, entry, bb->context, "different lock contexts for basic block");
+		/* Now that's not good.. */
+		if (bb->context >= 0)
+			return imbalance(ep, bb, entry, bb->context, "different lock contexts for basic block");
 
-	bb->context = entry;
-	entry += context_increase(bb, entry);
-	if (entry < 0)
-		return imbalance(ep, bb, entry, exit, "unexpected unlock");
+		bb->context = entry;
+		entry += context_increase(bb, entry);
+		if (entry < 0)
+			return imbalance(ep, bb, entry, exit, "unexpected unlock");
+
+		insn = last_instruction(bb->insns);
+		if (!insn)
+			continue;
+		if (insn->opcode == OP_RET) {
+			if (entry != exit)
+				return imbalance(ep, bb, entry, exit, "wrong count at exit");
+			continue;
+		}
 
-	return check_children(ep, bb, entry, exit);
+		/* The first child is the next one to look at */
+		FOR_EACH_PTR_REVERSE(bb->children, child) {
+			push_context_walk(child, entry);
+		} END_FOR_EACH_PTR_REVERSE(child);
+	}
+	return 0;
 }
 
 static void check_cast_instruction(struct instruction *insn)
@@ -163,13 +195,9 @@ static void check_byte_count(struct instruction *insn, pseudo_t count)
 
 static pseudo_t argument(struct instruction *call, unsigned int argno)
 {
-	pseudo_t args[8];
 	struct ptr_list *arg_list = (struct ptr_list *) call->arguments;
 
-	argno--;
-	if (linearize_ptr_list(arg_list, (void *)args, 8) > argno)
-		return args[argno];
-	return NULL;
+	return ptr_list_nth_entry(arg_list, argno - 1);
 }
 
 static void check_memset(struct instruction *insn)
@@ -186,16 +214,17 @@ struct checkfn {
 	void (*check)(struct instruction *insn);
 };
 
+static const struct checkfn check_fn[] = {
+	{ &memset_ident, check_memset },
+	{ &memcpy_ident, check_memcpy },
+	{ &copy_to_user_ident, check_ctu },
+	{ &copy_from_user_ident, check_cfu },
+};
+
 static void check_call_instruction(struct instruction *insn)
 {
 	pseudo_t fn = insn->func;
 	struct ident *ident;
-	static const struct checkfn check_fn[] = {
-		{ &memset_ident, check_memset },
-		{ &memcpy_ident, check_memcpy },
-		{ &copy_to_user_ident, check_ctu },
-		{ &copy_from_user_ident, check_cfu },
-	};
 	int i;
 
 	if (fn->type != PSEUDO_SYM)
@@ -271,6 +300,268 @@ static void check_context(struct entrypoint *ep)
 	check_bb_context(ep, ep->entry->bb, in_context, out_context);
 }
 
+/*
+ * Most functions can't trigger any of the checks above, and there's
+ * no point in linearizing them.  A quick look at the expanded tree
+ * tells: it says yes for anything that could become a context change,
+ * a range check or a call to one of the checked functions, but also
+ * for what the simplification itself can warn about: right shifts,
+ * and accesses to a symbol that aren't obviously within its bounds.
+ */
+static int scan_expression(struct expression *expr);
+static int scan_statement(struct statement *stmt);
+
+static int scan_expression_list(struct expression_list *list)
+{
+	struct expression *expr;
+
+	FOR_EACH_PTR(list, expr) {
+		if (scan_expression(expr))
+			return 1;
+	} END_FOR_EACH_PTR(expr);
+	return 0;
+}
+
+static int scan_symbol_list(struct symbol_list *list)
+{
+	struct symbol *sym;
+
+	FOR_EACH_PTR(list, sym) {
+		if (scan_expression(sym->initializer))
+			return 1;
+	} END_FOR_EACH_PTR(sym);
+	return 0;
+}
+
+static int is_function_symbol(struct symbol *sym)
+{
+	struct symbol *type = sym ? sym->ctype.base_type : NULL;
+
+	return type && type->type == SYM_FN;
+}
+
+static int scan_function(struct symbol *sym)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(check_fn); i++) {
+		if (check_fn[i].id == sym->ident)
+			return 1;
+	}
+	return 0;
+}
+
+/* The size of the load or store, as linearize_address_gen() does it */
+static int access_size(struct symbol *ctype)
+{
+	struct symbol *base = ctype;
+
+	if (base->type == SYM_NODE)
+		base = base->ctype.base_type;
+	if (base && base->type == SYM_BITFIELD)
+		return base->ctype.base_type->bit_size;
+	return ctype->bit_size;
+}
+
+static int scan_access(struct expression *expr)
+{
+	struct expression *addr = expr->unop;
+	long long offset = 0;
+	struct symbol *sym;
+
+	while (addr->type == EXPR_BINOP && addr->op == '+' && addr->right->type == EXPR_VALUE) {
+		offset += addr->right->value;
+		addr = addr->left;
+	}
+	if (addr->type != EXPR_SYMBOL)
+		return scan_expression(expr->unop);
+
+	sym = addr->symbol;
+	if (!sym || !expr->ctype)
+		return 1;
+	if (is_function_symbol(sym))
+		return scan_function(sym);
+	if (sym->bit_size <= 0)
+		return 0;
+	return offset < 0 || bytes_to_bits(offset) + access_size(expr->ctype) > sym->bit_size;
+}
+
+static int scan_call(struct expression *expr)
+{
+	struct expression *fn = expr->fn;
+	struct expression *arg;
+
+	if (fn->ctype && fn->ctype->ctype.contexts)
+		return 1;
+	if (scan_expression(fn))
+		return 1;
+
+	FOR_EACH_PTR(expr->args, arg) {
+		struct expression *value = arg;
+
+		/* Passing the address of a symbol is fine */
+		while (value->type == EXPR_CAST || value->type == EXPR_IMPLIED_CAST)
+			value = value->cast_expression;
+		if (value->type == EXPR_SYMBOL && value->symbol && !is_function_symbol(value->symbol))
+			continue;
+		if (scan_expression(arg))
+			return 1;
+	} END_FOR_EACH_PTR(arg);
+	return 0;
+}
+
+static int scan_expression(struct expression *expr)
+{
+	if (!expr)
+		return 0;
+
+	switch (expr->type) {
+	case EXPR_VALUE: case EXPR_FVALUE:
+	case EXPR_STRING: case EXPR_LABEL:
+	case EXPR_TYPE:
+	case EXPR_SIZEOF: case EXPR_PTRSIZEOF: case EXPR_ALIGNOF:
+		return 0;
+
+	case EXPR_SYMBOL:
+		/* The address of an object going anywhere */
+		if (!is_function_symbol(expr->symbol))
+			return 1;
+		return scan_function(expr->symbol);
+
+	case EXPR_BINOP:
+		if (expr->op == SPECIAL_RIGHTSHIFT)
+			return 1;
+		/* fall through */
+	case EXPR_LOGICAL: case EXPR_COMPARE: case EXPR_COMMA:
+		return scan_expression(expr->left) || scan_expression(expr->right);
+
+	case EXPR_ASSIGNMENT:
+		if (expr->op == SPECIAL_SHR_ASSIGN)
+			return 1;
+		return scan_expression(expr->left) || scan_expression(expr->right);
+
+	case EXPR_PREOP:
+		if (expr->op == '*')
+			return scan_access(expr);
+		/* fall through */
+	case EXPR_POSTOP:
+		return scan_expression(expr->unop);
+
+	case EXPR_CAST: case EXPR_FORCE_CAST: case EXPR_IMPLIED_CAST:
+		return scan_expression(expr->cast_expression);
+
+	case EXPR_SLICE:
+		return scan_expression(expr->base);
+
+	case EXPR_CONDITIONAL: case EXPR_SELECT:
+		return scan_expression(expr->conditional) ||
+			scan_expression(expr->cond_true) ||
+			scan_expression(expr->cond_false);
+
+	case EXPR_STATEMENT:
+		return scan_statement(expr->statement);
+
+	case EXPR_CALL:
+		return scan_call(expr);
+
+	case EXPR_INITIALIZER:
+		return scan_expression_list(expr->expr_list);
+	case EXPR_IDENTIFIER:
+		return scan_expression(expr->ident_expression);
+	case EXPR_INDEX:
+		return scan_expression(expr->idx_expression);
+	case EXPR_POS:
+		return scan_expression(expr->init_expr);
+
+	default:
+		return 1;
+	}
+}
+
+static int scan_statement(struct statement *stmt)
+{
+	struct statement *s;
+
+	if (!stmt)
+		return 0;
+
+	switch (stmt->type) {
+	case STMT_NONE:
+		return 0;
+
+	case STMT_CONTEXT: case STMT_RANGE: case STMT_ASM:
+		return 1;
+
+	case STMT_DECLARATION:
+		return scan_symbol_list(stmt->declaration);
+
+	case STMT_EXPRESSION:
+		return scan_expression(stmt->expression);
+
+	case STMT_RETURN:
+		return scan_expression(stmt->ret_value);
+
+	case STMT_CASE:
+		return scan_statement(stmt->case_statement);
+
+	case STMT_LABEL:
+		return scan_statement(stmt->label_statement);
+
+	case STMT_GOTO:
+		return scan_expression(stmt->goto_expression);
+
+	case STMT_COMPOUND:
+		if (scan_statement(stmt->args))
+			return 1;
+		FOR_EACH_PTR(stmt->stmts, s) {
+			if (scan_statement(s))
+				return 1;
+		} END_FOR_EACH_PTR(s);
+		return 0;
+
+	case STMT_IF:
+		return scan_expression(stmt->if_conditional) ||
+			scan_statement(stmt->if_true) ||
+			scan_statement(stmt->if_false);
+
+	case STMT_SWITCH:
+		return scan_expression(stmt->switch_expression) ||
+			scan_statement(stmt->switch_statement);
+
+	case STMT_ITERATOR:
+		return scan_symbol_list(stmt->iterator_syms) ||
+			scan_statement(stmt->iterator_pre_statement) ||
+			scan_expression(stmt->iterator_pre_condition) ||
+			scan_statement(stmt->iterator_statement) ||
+			scan_statement(stmt->iterator_post_statement) ||
+			scan_expression(stmt->iterator_post_condition);
+
+	default:
+		return 1;
+	}
+}
+
+static int need_linearize(struct symbol *sym)
+{
+	struct symbol *base_type = sym->ctype.base_type;
+	struct context *context;
+	int in_context = 0, out_context = 0;
+
+	if (flinearize_all || verbose || dbg_entry || dbg_dead)
+		return 1;
+	if (!base_type || base_type->type != SYM_FN || !base_type->stmt)
+		return 0;
+
+	FOR_EACH_PTR(sym->ctype.contexts, context) {
+		in_context += context->in;
+		out_context += context->out;
+	} END_FOR_EACH_PTR(context);
+	if (in_context != out_context)
+		return 1;
+
+	return scan_statement(base_type->stmt);
+}
+
 static void check_symbols(struct symbol_list *list)
 {
 	struct symbol *sym;
@@ -279,10 +570,16 @@ static void check_symbols(struct symbol_list *list)
 		struct entrypoint *ep;
 
 		expand_symbol(sym);
+		if (!need_linearize(sym))
+			continue;
 		ep = linearize_symbol(sym);
 		if (ep) {
-			if (dbg_entry)
+			if (dbg_entry) {
 				show_entry(ep);
+				printf("%s: %u cse rounds, %u full, %u insns requeued\n\n",
+					show_ident(sym->ident), ep->cse_rounds,
+					ep->cse_sweeps, ep->cse_requeued);
+			}
 
 			check_context(ep);
 		}
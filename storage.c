@@ -8,6 +8,7 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "symbol.h"
@@ -18,14 +19,100 @@
 ALLOCATOR(storage, "storages");
 ALLOCATOR(storage_hash, "storage hash");
 
-#define MAX_STORAGE_HASH 64
-static struct storage_hash_list *storage_hash_table[MAX_STORAGE_HASH];
+/*
+ * Two open-addressing tables: one for the storage of each
+ * (bb, pseudo, inout), and one with the list of these entries
+ * for each (bb, inout), so that gather_storage() doesn't have
+ * to look at everything.  Both are kept at most half full.
+ */
+#define STORAGE_HASH_MIN 256
+
+struct storage_bb {
+	struct basic_block *bb;
+	enum inout_enum inout;
+	struct storage_hash_list *list;
+};
+
+static struct storage_hash **storage_table;
+static unsigned int storage_table_size, storage_table_nr;
+
+static struct storage_bb *storage_bbs;
+static unsigned int storage_bbs_size, storage_bbs_nr;
+
+static inline unsigned long storage_hash(struct basic_block *bb, pseudo_t pseudo, enum inout_enum inout)
+{
+	unsigned long hash = hashval(bb) / 8 * 0x9e3779b1 + hashval(pseudo) / 8;
+
+	hash = hash * 0x85ebca6b + inout;
+	return hash ^ (hash >> 16);
+}
+
+static struct storage_hash **storage_slot(struct basic_block *bb, pseudo_t pseudo, enum inout_enum inout)
+{
+	unsigned int mask = storage_table_size - 1;
+	unsigned int i = storage_hash(bb, pseudo, inout) & mask;
+	struct storage_hash *hash;
 
-static inline unsigned int storage_hash(struct basic_block *bb, pseudo_t pseudo, enum inout_enum inout)
+	while ((hash = storage_table[i]) != NULL) {
+		if (hash->bb == bb && hash->pseudo == pseudo && hash->inout == inout)
+			break;
+		i = (i + 1) & mask;
+	}
+	return storage_table + i;
+}
+
+static struct storage_bb *storage_bb_slot(struct basic_block *bb, enum inout_enum inout)
 {
-	unsigned hash = hashval(bb) + hashval(pseudo) + hashval(inout);
-	hash += hash / MAX_STORAGE_HASH;
-	return hash & (MAX_STORAGE_HASH-1);
+	unsigned int mask = storage_bbs_size - 1;
+	unsigned int i = storage_hash(bb, NULL, inout) & mask;
+	struct storage_bb *entry;
+
+	for (;;) {
+		entry = storage_bbs + i;
+		if (!entry->bb || (entry->bb == bb && entry->inout == inout))
+			return entry;
+		i = (i + 1) & mask;
+	}
+}
+
+static void grow_storage_table(void)
+{
+	struct storage_hash **old = storage_table;
+	unsigned int i, size = storage_table_size;
+
+	storage_table_size = size ? size * 2 : STORAGE_HASH_MIN;
+	storage_table = calloc(storage_table_size, sizeof(*storage_table));
+	if (!storage_table)
+		die("out of memory for storage hash");
+	for (i = 0; i < size; i++) {
+		struct storage_hash *hash = old[i];
+		if (hash)
+			*storage_slot(hash->bb, hash->pseudo, hash->inout) = hash;
+	}
+	free(old);
+}
+
+static void grow_storage_bbs(void)
+{
+	struct storage_bb *old = storage_bbs;
+	unsigned int i, size = storage_bbs_size;
+
+	storage_bbs_size = size ? size * 2 : STORAGE_HASH_MIN;
+	storage_bbs = calloc(storage_bbs_size, sizeof(*storage_bbs));
+	if (!storage_bbs)
+		die("out of memory for storage hash");
+	for (i = 0; i < size; i++) {
+		if (old[i].bb)
+			*storage_bb_slot(old[i].bb, old[i].inout) = old[i];
+	}
+	free(old);
+}
+
+static struct storage_hash_list *storage_bb_list(struct basic_block *bb, enum inout_enum inout)
+{
+	if (!storage_bbs_nr)
+		return NULL;
+	return storage_bb_slot(bb, inout)->list;
 }
 
 static int hash_list_cmp(const void *_a, const void *_b)
@@ -44,72 +131,75 @@ static void sort_hash_list(struct storage_hash_list **listp)
 
 struct storage_hash_list *gather_storage(struct basic_block *bb, enum inout_enum inout)
 {
-	int i;
-	struct storage_hash *entry, *prev;
 	struct storage_hash_list *list = NULL;
 
-	for (i = 0; i < MAX_STORAGE_HASH; i++) {
-		struct storage_hash *hash;
-		FOR_EACH_PTR(storage_hash_table[i], hash) {
-			if (hash->bb == bb && hash->inout == inout)
-				add_ptr_list(&list, hash);
-		} END_FOR_EACH_PTR(hash);
-	}
+	concat_ptr_list((struct ptr_list *)storage_bb_list(bb, inout), (struct ptr_list **)&list);
 	sort_hash_list(&list);
-
-	prev = NULL;
-	FOR_EACH_PTR(list, entry) {
-		if (prev && entry->pseudo == prev->pseudo) {
-			assert(entry == prev);
-			DELETE_CURRENT_PTR(entry);
-		}
-		prev = entry;
-	} END_FOR_EACH_PTR(entry);
-	PACK_PTR_LIST(&list);
 	return list;
 }
 
-static void name_storage(void)
+static void name_storage(struct entrypoint *ep)
 {
-	int i;
+	struct basic_block *bb;
 	int name = 0;
 
-	for (i = 0; i < MAX_STORAGE_HASH; i++) {
-		struct storage_hash *hash;
-		FOR_EACH_PTR(storage_hash_table[i], hash) {
-			struct storage *storage = hash->storage;
-			if (storage->name)
-				continue;
-			storage->name = ++name;
-		} END_FOR_EACH_PTR(hash);
-	}
+	FOR_EACH_PTR(ep->bbs, bb) {
+		enum inout_enum inout;
+
+		for (inout = STOR_IN; inout <= STOR_OUT; inout++) {
+			struct storage_hash *hash;
+			FOR_EACH_PTR(storage_bb_list(bb, inout), hash) {
+				struct storage *storage = hash->storage;
+				if (storage->name)
+					continue;
+				storage->name = ++name;
+			} END_FOR_EACH_PTR(hash);
+		}
+	} END_FOR_EACH_PTR(bb);
 }
 
 struct storage *lookup_storage(struct basic_block *bb, pseudo_t pseudo, enum inout_enum inout)
 {
-	struct storage_hash_list *list = storage_hash_table[storage_hash(bb,pseudo,inout)];
-	struct storage_hash *hash;
+	struct storage_hash *hash = lookup_storage_hash(bb, pseudo, inout);
 
-	FOR_EACH_PTR(list, hash) {
-		if (hash->bb == bb && hash->pseudo == pseudo && hash->inout == inout)
-			return hash->storage;
-	} END_FOR_EACH_PTR(hash);
-	return NULL;
+	return hash ? hash->storage : NULL;
+}
+
+struct storage_hash *lookup_storage_hash(struct basic_block *bb, pseudo_t pseudo, enum inout_enum inout)
+{
+	if (!storage_table_nr)
+		return NULL;
+	return *storage_slot(bb, pseudo, inout);
 }
 
 void add_storage(struct storage *storage, struct basic_block *bb, pseudo_t pseudo, enum inout_enum inout)
 {
-	struct storage_hash_list **listp = storage_hash_table + storage_hash(bb,pseudo,inout);
 	struct storage_hash *hash = alloc_storage_hash(storage);
+	struct storage_hash **slot;
+	struct storage_bb *entry;
 
 	hash->bb = bb;
 	hash->pseudo = pseudo;
 	hash->inout = inout;
 
-	add_ptr_list(listp, hash);
+	if (2 * (storage_table_nr + 1) > storage_table_size)
+		grow_storage_table();
+	slot = storage_slot(bb, pseudo, inout);
+	assert(!*slot);
+	*slot = hash;
+	storage_table_nr++;
+
+	if (2 * (storage_bbs_nr + 1) > storage_bbs_size)
+		grow_storage_bbs();
+	entry = storage_bb_slot(bb, inout);
+	if (!entry->bb) {
+		entry->bb = bb;
+		entry->inout = inout;
+		storage_bbs_nr++;
+	}
+	add_ptr_list(&entry->list, hash);
 }
 
-
 static int storage_hash_cmp(const void *_a, const void *_b)
 {
 	const struct storage_hash *a = _a;
@@ -159,12 +249,22 @@ static void vrfy_storage(struct storage_hash_list **listp)
 
 void free_storage(void)
 {
-	int i;
+	unsigned int i;
 
-	for (i = 0; i < MAX_STORAGE_HASH; i++) {
-		vrfy_storage(storage_hash_table + i);
-		free_ptr_list(storage_hash_table + i);
+	for (i = 0; i < storage_bbs_size; i++) {
+		struct storage_bb *entry = storage_bbs + i;
+
+		if (!entry->bb)
+			continue;
+		vrfy_storage(&entry->list);
+		free_ptr_list(&entry->list);
+		entry->bb = NULL;
 	}
+	storage_bbs_nr = 0;
+
+	if (storage_table_nr)
+		memset(storage_table, 0, storage_table_size * sizeof(*storage_table));
+	storage_table_nr = 0;
 }
 
 const char *show_storage(struct storage *s)
@@ -303,5 +403,5 @@ void set_up_storage(struct entrypoint *ep)
 		combine_phi_storage(bb);
 	} END_FOR_EACH_PTR(bb);
 
-	name_storage();
+	name_storage(ep);
 }
@@ -56,6 +56,7 @@ extern void free_storage(void);
 extern const char *show_storage(struct storage *);
 extern void set_up_storage(struct entrypoint *);
 struct storage *lookup_storage(struct basic_block *, pseudo_t, enum inout_enum);
+struct storage_hash *lookup_storage_hash(struct basic_block *, pseudo_t, enum inout_enum);
 void add_storage(struct storage *, struct basic_block *, pseudo_t, enum inout_enum);
 
 DECLARE_ALLOCATOR(storage);
@@ -55,11 +55,21 @@ void access_symbol(struct symbol *sym)
 	}
 }
 
+static struct lookup_stats {
+	unsigned long lookups, steps;
+} lookup_stats;
+
+/*
+ * The first symbol of the right namespace in the chain of its class
+ * is the visible one.
+ */
 struct symbol *lookup_symbol(struct ident *ident, enum namespace ns)
 {
 	struct symbol *sym;
 
-	for (sym = ident->symbols; sym; sym = sym->next_id) {
+	lookup_stats.lookups++;
+	for (sym = *ident_symbols(ident, ns); sym; sym = sym->next_id) {
+		lookup_stats.steps++;
 		if (sym->namespace & ns) {
 			sym->used = 1;
 			return sym;
@@ -68,11 +78,25 @@ struct symbol *lookup_symbol(struct ident *ident, enum namespace ns)
 	return NULL;
 }
 
+void show_lookup_stats(void)
+{
+	fprintf(stderr, "symbol lookups: %lu, %.2f average chain length walked\n",
+		lookup_stats.lookups,
+		lookup_stats.lookups ? (double) lookup_stats.steps / lookup_stats.lookups : 0.0);
+}
+
 struct context *alloc_context(void)
 {
 	return __alloc_context(0);
 }
 
+struct symbol_cold *symbol_cold(struct symbol *sym)
+{
+	if (!sym->cold)
+		sym->cold = __alloc_symbol_cold(0);
+	return sym->cold;
+}
+
 struct symbol *alloc_symbol(struct position pos, int type)
 {
 	struct symbol *sym = __alloc_symbol(0);
@@ -228,7 +252,7 @@ static struct symbol * examine_array_type(struct symbol *sym)
 {
 	struct symbol *base_type = examine_base_type(sym);
 	unsigned long bit_size = -1, alignment;
-	struct expression *array_size = sym->array_size;
+	struct expression *array_size = cold_field(sym, array_size);
 
 	if (!base_type)
 		return sym;
@@ -595,9 +619,10 @@ void check_declaration(struct symbol *sym)
 	}
 }
 
-void bind_symbol(struct symbol *sym, struct ident *ident, enum namespace ns)
+void bind_symbol_with_scope(struct symbol *sym, struct ident *ident, enum namespace ns, struct scope *scope)
 {
-	struct scope *scope;
+	struct symbol **head;
+
 	if (sym->bound) {
 		sparse_error(sym->pos, "internal error: symbol type already bound");
 		return;
@@ -607,14 +632,20 @@ void bind_symbol(struct symbol *sym, struct ident *ident, enum namespace ns)
 		return;
 	}
 	sym->namespace = ns;
-	sym->next_id = ident->symbols;
-	ident->symbols = sym;
+	head = ident_symbols(ident, ns);
+	sym->next_id = *head;
+	*head = sym;
 	if (sym->ident && sym->ident != ident)
 		warning(sym->pos, "Symbol '%s' already bound", show_ident(sym->ident));
 	sym->ident = ident;
 	sym->bound = 1;
+	bind_scope(sym, scope);
+}
+
+void bind_symbol(struct symbol *sym, struct ident *ident, enum namespace ns)
+{
+	struct scope *scope = block_scope;
 
-	scope = block_scope;
 	if (ns == NS_SYMBOL && toplevel(scope)) {
 		unsigned mod = MOD_ADDRESSABLE | MOD_TOPLEVEL;
 
@@ -630,7 +661,7 @@ void bind_symbol(struct symbol *sym, struct ident *ident, enum namespace ns)
 		scope = file_scope;
 	if (ns == NS_LABEL)
 		scope = function_scope;
-	bind_scope(sym, scope);
+	bind_symbol_with_scope(sym, ident, ns, scope);
 }
 
 struct symbol *create_symbol(int stream, const char *name, int type, int namespace)
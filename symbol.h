@@ -135,6 +135,21 @@ extern int expand_constant_p(struct expression *expr, int cost);
 #define SYM_ATTR_NORMAL		1
 #define SYM_ATTR_STRONG		2
 
+/*
+ * The parts of a C symbol that only a few symbols ever need: array
+ * sizes, inline function bodies, the definition of multiply declared
+ * functions and the linearized entrypoint. They are allocated on first
+ * store (see symbol_cold()) instead of taking room in every symbol,
+ * which keeps struct symbol within three cache lines.
+ */
+struct symbol_cold {
+	struct expression *array_size;
+	struct statement *inline_stmt;
+	struct symbol_list *inline_symbol_list;
+	struct symbol *definition;
+	struct entrypoint *ep;
+};
+
 struct symbol {
 	enum type type:8;
 	enum namespace namespace:9;
@@ -176,17 +191,13 @@ struct symbol {
 					designated_init:1,
 					forced_arg:1,
 					transparent_union:1;
-			struct expression *array_size;
 			struct ctype ctype;
 			struct symbol_list *arguments;
 			struct statement *stmt;
 			struct symbol_list *symbol_list;
-			struct statement *inline_stmt;
-			struct symbol_list *inline_symbol_list;
 			struct expression *initializer;
-			struct entrypoint *ep;
 			long long value;		/* Initial value */
-			struct symbol *definition;
+			struct symbol_cold *cold;	/* Rarely used fields, may be NULL */
 		};
 	};
 	union /* backend */ {
@@ -288,6 +299,32 @@ extern const char * type_difference(struct ctype *c1, struct ctype *c2,
 	unsigned long mod1, unsigned long mod2);
 
 extern struct symbol *lookup_symbol(struct ident *, enum namespace);
+extern void show_lookup_stats(void);
+
+/*
+ * The symbols of an identifier are chained per class of namespaces,
+ * innermost scope first. The namespaces that are looked up together
+ * (the ordinary identifiers and the keywords and typedefs they can
+ * be, a macro and its #undef) are in the same class.
+ */
+static inline struct symbol **ident_symbols(struct ident *ident, enum namespace ns)
+{
+	int class;
+
+	if (ns & (NS_SYMBOL | NS_TYPEDEF | NS_KEYWORD))
+		class = 0;
+	else if (ns & NS_STRUCT)
+		class = 1;
+	else if (ns & NS_LABEL)
+		class = 2;
+	else if (ns & NS_ITERATOR)
+		class = 3;
+	else if (ns & (NS_MACRO | NS_UNDEF))
+		class = 4;
+	else
+		class = 5;
+	return &ident->symbols[class];
+}
 extern struct symbol *create_symbol(int stream, const char *name, int type, int namespace);
 extern void init_symbols(void);
 extern void init_ctype(void);
@@ -300,6 +337,7 @@ extern void show_type_list(struct symbol *);
 extern void show_symbol_list(struct symbol_list *, const char *);
 extern void add_symbol(struct symbol_list **, struct symbol *);
 extern void bind_symbol(struct symbol *, struct ident *, enum namespace);
+extern void bind_symbol_with_scope(struct symbol *, struct ident *, enum namespace, struct scope *);
 
 extern struct symbol *examine_symbol_type(struct symbol *);
 extern struct symbol *examine_pointer_target(struct symbol *);
@@ -313,6 +351,11 @@ extern void debug_symbol(struct symbol *);
 extern void merge_type(struct symbol *sym, struct symbol *base_type);
 extern void check_declaration(struct symbol *sym);
 
+extern struct symbol_cold *symbol_cold(struct symbol *sym);
+
+/* Read a field of the cold part, without allocating it */
+#define cold_field(sym, field) ((sym)->cold ? (sym)->cold->field : NULL)
+
 static inline struct symbol *get_base_type(const struct symbol *sym)
 {
 	return examine_symbol_type(sym->ctype.base_type);
@@ -1,3 +1,8 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "allocate.h"
 #include "dissect.h"
 
 static unsigned dotc_stream;
@@ -76,22 +81,697 @@ static void r_symdef(struct symbol *sym)
 	r_symbol(-1, &sym->pos, sym);
 }
 
+/*
+ * -fdissect-binary=FILE writes the same reports in binary to FILE, and
+ * an index by name to FILE.idx. All integers are unsigned LEB128
+ * varints unless said otherwise, "sN" is a signed one zigzag encoded,
+ * and "u64" is 8 bytes, little-endian.
+ *
+ * FILE:	"SPDISSCT"
+ *		blocks of up to DISSECT_BLOCK reports:
+ *			nr, size of the columns in bytes
+ *			nr modes (~0 for a definition)
+ *			nr storage classes, one byte each ('g', 's' or 'l')
+ *			nr file names
+ *			nr lines, as sN deltas from the previous one
+ *			nr columns
+ *			nr symbol names (the struct for a member access)
+ *			nr member names plus one, 0 for a symbol access
+ *			nr type names
+ *		nr strings, each as its length and its bytes
+ *		u64 offset of the strings, "SPDISSCT"
+ *
+ * The names are indexes in the strings, in the order of their first
+ * use. The reports are numbered from 0 across the blocks.
+ *
+ * FILE.idx:	"SPDISIDX"
+ *		nr blocks, u64 offset of each block in FILE
+ *		nr names, sorted with strcmp(); for each of them the name
+ *		(length, bytes), the number of reports and their numbers,
+ *		as deltas from the previous one
+ *
+ * A symbol is indexed under its name, a member as "struct.member", so
+ * that all the accesses to one of them are found without a full scan.
+ *
+ * -fdissect-dump reads FILE back and prints it as the text report, and
+ * -fdissect-dump=NAME prints only the reports on NAME, decoding just
+ * the blocks that FILE.idx points to. Without input files, FILE is
+ * only read.
+ */
+#define DISSECT_MAGIC	"SPDISSCT"
+#define INDEX_MAGIC	"SPDISIDX"
+#define DISSECT_BLOCK	4096
+
+struct dissect_string {
+	char *str;
+	unsigned long hash;
+	unsigned int id;
+	unsigned long *refs;
+	int nr_refs;
+};
+
+struct dissect_report {
+	unsigned int mode, file, line, col, sym, mem, type;
+	char storage;
+};
+
+static FILE *bin;
+static struct dissect_report reports[DISSECT_BLOCK];
+static int nr_reports;
+static unsigned long report_nr;
+
+static unsigned long long *block_offsets;
+static int nr_blocks;
+
+static struct dissect_string **strings;	/* by id */
+static struct dissect_string **string_hash;
+static unsigned int nr_strings, string_hash_size;
+
+static unsigned long hash_string(const char *str)
+{
+	unsigned long hash = 5381;
+
+	while (*str)
+		hash = hash * 33 + (unsigned char)*str++;
+	return hash;
+}
+
+static void grow_string_hash(void)
+{
+	struct dissect_string **old = string_hash;
+	unsigned int i, old_size = string_hash_size;
+
+	string_hash_size = old_size ? old_size * 2 : 1024;
+	string_hash = calloc(string_hash_size, sizeof(*string_hash));
+	if (!string_hash)
+		die("out of memory");
+	for (i = 0; i < old_size; i++) {
+		struct dissect_string *s = old[i];
+		unsigned int slot;
+
+		if (!s)
+			continue;
+		slot = s->hash & (string_hash_size - 1);
+		while (string_hash[slot])
+			slot = (slot + 1) & (string_hash_size - 1);
+		string_hash[slot] = s;
+	}
+	free(old);
+}
+
+static struct dissect_string *intern(const char *str)
+{
+	unsigned long hash = hash_string(str);
+	struct dissect_string *s;
+	unsigned int slot;
+
+	if (2 * (nr_strings + 1) > string_hash_size)
+		grow_string_hash();
+	slot = hash & (string_hash_size - 1);
+	while ((s = string_hash[slot]) != NULL) {
+		if (s->hash == hash && !strcmp(s->str, str))
+			return s;
+		slot = (slot + 1) & (string_hash_size - 1);
+	}
+
+	s = calloc(1, sizeof(*s));
+	if (!s || !(s->str = strdup(str)))
+		die("out of memory");
+	s->hash = hash;
+	s->id = nr_strings;
+	strings = grow_array(strings, nr_strings, sizeof(*strings));
+	strings[nr_strings++] = s;
+	string_hash[slot] = s;
+	return s;
+}
+
+static void add_ref(struct dissect_string *s)
+{
+	s->refs = grow_array(s->refs, s->nr_refs, sizeof(*s->refs));
+	s->refs[s->nr_refs++] = report_nr;
+}
+
+static void put_varint(FILE *f, unsigned long long val)
+{
+	while (val >= 0x80) {
+		putc((val & 0x7f) | 0x80, f);
+		val >>= 7;
+	}
+	putc(val, f);
+}
+
+static void put_u64(FILE *f, unsigned long long val)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		putc(val >> (8 * i), f);
+}
+
+static void put_string(FILE *f, const char *str)
+{
+	size_t len = strlen(str);
+
+	put_varint(f, len);
+	fwrite(str, 1, len, f);
+}
+
+static int varint_size(unsigned long long val)
+{
+	int size = 1;
+
+	while (val >= 0x80) {
+		val >>= 7;
+		size++;
+	}
+	return size;
+}
+
+static unsigned long long zigzag(long long val)
+{
+	return ((unsigned long long)val << 1) ^ (val >> 63);
+}
+
+#define FOR_EACH_COLUMN(expr)	do {					\
+	for (i = 0, line = 0; i < nr_reports; i++) {			\
+		struct dissect_report *r = reports + i;			\
+		expr;							\
+		line = r->line;						\
+	}								\
+} while (0)
+
+static void flush_reports(void)
+{
+	unsigned long long size = 0;
+	unsigned int line;
+	int i;
+
+	if (!nr_reports)
+		return;
+
+	/* Columns of varints, but for the storage classes */
+	FOR_EACH_COLUMN(size += varint_size(r->mode) + 1 +
+			varint_size(r->file) +
+			varint_size(zigzag((long long)r->line - line)) +
+			varint_size(r->col) + varint_size(r->sym) +
+			varint_size(r->mem) + varint_size(r->type));
+
+	block_offsets = grow_array(block_offsets, nr_blocks, sizeof(*block_offsets));
+	block_offsets[nr_blocks++] = ftell(bin);
+	put_varint(bin, nr_reports);
+	put_varint(bin, size);
+	FOR_EACH_COLUMN(put_varint(bin, r->mode));
+	FOR_EACH_COLUMN(putc(r->storage, bin));
+	FOR_EACH_COLUMN(put_varint(bin, r->file));
+	FOR_EACH_COLUMN(put_varint(bin, zigzag((long long)r->line - line)));
+	FOR_EACH_COLUMN(put_varint(bin, r->col));
+	FOR_EACH_COLUMN(put_varint(bin, r->sym));
+	FOR_EACH_COLUMN(put_varint(bin, r->mem));
+	FOR_EACH_COLUMN(put_varint(bin, r->type));
+	nr_reports = 0;
+}
+
+static void add_report(unsigned mode, char storage, const char *file,
+		       unsigned int line, unsigned int col,
+		       unsigned int sym, unsigned int mem, const char *type)
+{
+	struct dissect_report *r = reports + nr_reports;
+
+	r->mode = mode;
+	r->storage = storage;
+	r->file = intern(file)->id;
+	r->line = line;
+	r->col = col;
+	r->sym = sym;
+	r->mem = mem;
+	r->type = intern(type)->id;
+
+	report_nr++;
+	if (++nr_reports == DISSECT_BLOCK)
+		flush_reports();
+}
+
+/*
+ * With -fjobs=N the workers don't number anything: they write their
+ * reports as records, and the parent replays them in the order of the
+ * files, so that the strings and the reports get the numbers they
+ * would have had in a single process.
+ *
+ * Record:	mode, storage class (one byte), file name, line, column,
+ *		1 or 2 names (the symbol, or the struct and the member),
+ *		type name
+ */
+static FILE *records;
+
+static void put_record(unsigned mode, char storage, const char *file,
+		       unsigned int line, unsigned int col,
+		       const char *name, const char *member, const char *type)
+{
+	put_varint(records, mode);
+	putc(storage, records);
+	put_string(records, file);
+	put_varint(records, line);
+	put_varint(records, col);
+	putc(member ? 2 : 1, records);
+	put_string(records, name);
+	if (member)
+		put_string(records, member);
+	put_string(records, type);
+}
+
+/* Number the strings of a report, in the same order everywhere */
+static void number_report(unsigned mode, char storage, const char *file,
+			  unsigned int line, unsigned int col,
+			  const char *name, const char *member, const char *type)
+{
+	struct dissect_string *s;
+	unsigned int sym, mem = 0;
+
+	if (member) {
+		char key[512];
+
+		snprintf(key, sizeof(key), "%s.%s", name, member);
+		add_ref(intern(key));
+		sym = intern(name)->id;
+		mem = intern(member)->id + 1;
+	} else {
+		s = intern(name);
+		add_ref(s);
+		sym = s->id;
+	}
+	add_report(mode, storage, file, line, col, sym, mem, type);
+}
+
+static void report(unsigned mode, char storage, struct position *pos,
+		   const char *name, const char *member, const char *type)
+{
+	const char *file = stream_name(pos->stream);
+
+	if (records)
+		put_record(mode, storage, file, pos->line, pos->pos,
+			   name, member, type);
+	else
+		number_report(mode, storage, file, pos->line, pos->pos,
+			      name, member, type);
+}
+
+static void b_symbol(unsigned mode, struct position *pos, struct symbol *sym)
+{
+	if (!sym->ident)
+		sym->ident = MK_IDENT("__asm__");
+
+	report(mode, storage(sym), pos, show_ident(sym->ident), NULL,
+	       show_typename(sym->ctype.base_type));
+}
+
+static void b_member(unsigned mode, struct position *pos, struct symbol *sym, struct symbol *mem)
+{
+	struct ident *ni, *si, *mi;
+	char name[256], member[256];
+
+	ni = MK_IDENT("?");
+	si = sym->ident ?: ni;
+	/* mem == NULL means entire struct accessed */
+	mi = mem ? (mem->ident ?: ni) : MK_IDENT("*");
+
+	snprintf(name, sizeof(name), "%.*s", si->len, si->name);
+	snprintf(member, sizeof(member), "%.*s", mi->len, mi->name);
+	report(mode, storage(sym), pos, name, member,
+	       show_typename(mem ? mem->ctype.base_type : sym));
+}
+
+static void b_symdef(struct symbol *sym)
+{
+	b_symbol(-1, &sym->pos, sym);
+}
+
+static int cmp_string(const void *a, const void *b)
+{
+	const struct dissect_string *s1 = *(const struct dissect_string * const *)a;
+	const struct dissect_string *s2 = *(const struct dissect_string * const *)b;
+
+	return strcmp(s1->str, s2->str);
+}
+
+static void write_index(const char *name)
+{
+	struct dissect_string **sorted;
+	unsigned int i, nr = 0;
+	FILE *idx = fopen(name, "w");
+	int j;
+
+	if (!idx)
+		die("can't open %s: %s", name, strerror(errno));
+	sorted = malloc((nr_strings + 1) * sizeof(*sorted));
+	if (!sorted)
+		die("out of memory");
+	for (i = 0; i < nr_strings; i++) {
+		if (strings[i]->nr_refs)
+			sorted[nr++] = strings[i];
+	}
+	qsort(sorted, nr, sizeof(*sorted), cmp_string);
+
+	fwrite(INDEX_MAGIC, 1, 8, idx);
+	put_varint(idx, nr_blocks);
+	for (j = 0; j < nr_blocks; j++)
+		put_u64(idx, block_offsets[j]);
+	put_varint(idx, nr);
+	for (i = 0; i < nr; i++) {
+		struct dissect_string *s = sorted[i];
+		unsigned long prev = 0;
+
+		put_string(idx, s->str);
+		put_varint(idx, s->nr_refs);
+		for (j = 0; j < s->nr_refs; j++) {
+			put_varint(idx, s->refs[j] - prev);
+			prev = s->refs[j];
+		}
+	}
+	free(sorted);
+	if (fclose(idx))
+		die("can't write %s: %s", name, strerror(errno));
+}
+
+static void open_binary(const char *name)
+{
+	bin = fopen(name, "w");
+	if (!bin)
+		die("can't open %s: %s", name, strerror(errno));
+	fwrite(DISSECT_MAGIC, 1, 8, bin);
+}
+
+static char *index_name(const char *name)
+{
+	char *idx_name = malloc(strlen(name) + 5);
+
+	if (!idx_name)
+		die("out of memory");
+	sprintf(idx_name, "%s.idx", name);
+	return idx_name;
+}
+
+static void close_binary(const char *name)
+{
+	unsigned long long offset;
+	char *idx_name;
+	unsigned int i;
+
+	flush_reports();
+	offset = ftell(bin);
+	put_varint(bin, nr_strings);
+	for (i = 0; i < nr_strings; i++)
+		put_string(bin, strings[i]->str);
+	put_u64(bin, offset);
+	fwrite(DISSECT_MAGIC, 1, 8, bin);
+	if (fclose(bin))
+		die("can't write %s: %s", name, strerror(errno));
+
+	idx_name = index_name(name);
+	write_index(idx_name);
+	free(idx_name);
+}
+
+static char **dump_strings;
+static unsigned int nr_dump_strings;
+
+static unsigned long long get_varint(FILE *f)
+{
+	unsigned long long val = 0;
+	int shift = 0, c;
+
+	do {
+		c = getc(f);
+		if (c == EOF)
+			die("dissect: truncated file");
+		val |= (unsigned long long)(c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	return val;
+}
+
+static unsigned long long get_u64(FILE *f)
+{
+	unsigned long long val = 0;
+	int i, c;
+
+	for (i = 0; i < 8; i++) {
+		c = getc(f);
+		if (c == EOF)
+			die("dissect: truncated file");
+		val |= (unsigned long long)c << (8 * i);
+	}
+	return val;
+}
+
+static char *get_string(FILE *f)
+{
+	size_t len = get_varint(f);
+	char *str = malloc(len + 1);
+
+	if (!str)
+		die("out of memory");
+	if (fread(str, 1, len, f) != len)
+		die("dissect: truncated file");
+	str[len] = '\0';
+	return str;
+}
+
+static void get_magic(FILE *f, const char *magic, const char *name)
+{
+	char buf[8];
+
+	if (fread(buf, 1, 8, f) != 8 || memcmp(buf, magic, 8))
+		die("%s: not a dissect file", name);
+}
+
+static long long unzigzag(unsigned long long val)
+{
+	return (long long)(val >> 1) ^ -(long long)(val & 1);
+}
+
+static const char *dump_string(unsigned int id)
+{
+	if (id >= nr_dump_strings)
+		die("dissect: bad string number %u", id);
+	return dump_strings[id];
+}
+
+/* Decode the block at the current position into reports[] */
+static int read_block(FILE *f)
+{
+	unsigned int line = 0;
+	int i, nr;
+
+	nr = get_varint(f);
+	if (nr > DISSECT_BLOCK)
+		die("dissect: bad block of %d reports", nr);
+	get_varint(f);		/* the size of the columns */
+	for (i = 0; i < nr; i++)
+		reports[i].mode = get_varint(f);
+	for (i = 0; i < nr; i++)
+		reports[i].storage = getc(f);
+	for (i = 0; i < nr; i++)
+		reports[i].file = get_varint(f);
+	for (i = 0; i < nr; i++)
+		reports[i].line = line += unzigzag(get_varint(f));
+	for (i = 0; i < nr; i++)
+		reports[i].col = get_varint(f);
+	for (i = 0; i < nr; i++)
+		reports[i].sym = get_varint(f);
+	for (i = 0; i < nr; i++)
+		reports[i].mem = get_varint(f);
+	for (i = 0; i < nr; i++)
+		reports[i].type = get_varint(f);
+	return nr;
+}
+
+/* The same lines as print_usage() and r_symbol() or r_member() */
+static void print_report(struct dissect_report *r)
+{
+	static unsigned int curr_file = -1;
+	const char *name = dump_string(r->sym);
+
+	if (curr_file != r->file) {
+		curr_file = r->file;
+		printf("\nFILE: %s\n\n", dump_string(r->file));
+	}
+
+	printf("%4u:%-3u %c %-5.3s", r->line, r->col, r->storage, show_mode(r->mode));
+	if (!r->mem)
+		printf("%-32s %s\n", name, dump_string(r->type));
+	else
+		printf("%s.%-*s %s\n", name, 32-1 - (int)strlen(name),
+			dump_string(r->mem - 1), dump_string(r->type));
+}
+
+static void dump_query(FILE *f, const char *name, const char *query)
+{
+	char *idx_name = index_name(name);
+	FILE *idx = fopen(idx_name, "r");
+	unsigned long long *offsets;
+	unsigned int i, nr_names;
+	int j, nr_blocks, block = -1, nr = 0;
+
+	if (!idx)
+		die("can't open %s: %s", idx_name, strerror(errno));
+	get_magic(idx, INDEX_MAGIC, idx_name);
+	nr_blocks = get_varint(idx);
+	offsets = malloc((nr_blocks + 1) * sizeof(*offsets));
+	if (!offsets)
+		die("out of memory");
+	for (j = 0; j < nr_blocks; j++)
+		offsets[j] = get_u64(idx);
+
+	nr_names = get_varint(idx);
+	for (i = 0; i < nr_names; i++) {
+		char *str = get_string(idx);
+		unsigned long nr_refs = get_varint(idx), ref = 0, k;
+		int found = !strcmp(str, query);
+
+		free(str);
+		for (k = 0; k < nr_refs; k++) {
+			ref += get_varint(idx);
+			if (!found)
+				continue;
+			if (ref / DISSECT_BLOCK != block) {
+				block = ref / DISSECT_BLOCK;
+				if (block >= nr_blocks)
+					die("%s: bad report number %lu", idx_name, ref);
+				fseek(f, offsets[block], SEEK_SET);
+				nr = read_block(f);
+			}
+			if (ref % DISSECT_BLOCK >= nr)
+				die("%s: bad report number %lu", idx_name, ref);
+			print_report(reports + ref % DISSECT_BLOCK);
+		}
+		if (found)
+			break;
+	}
+	free(offsets);
+	fclose(idx);
+	free(idx_name);
+}
+
+static void dump_binary(const char *name, const char *query)
+{
+	unsigned long long offset;
+	FILE *f = fopen(name, "r");
+	unsigned int i;
+
+	if (!f)
+		die("can't open %s: %s", name, strerror(errno));
+	if (fseek(f, -16, SEEK_END))
+		die("%s: not a dissect file", name);
+	offset = get_u64(f);
+	get_magic(f, DISSECT_MAGIC, name);
+
+	fseek(f, offset, SEEK_SET);
+	nr_dump_strings = get_varint(f);
+	dump_strings = malloc((nr_dump_strings + 1) * sizeof(*dump_strings));
+	if (!dump_strings)
+		die("out of memory");
+	for (i = 0; i < nr_dump_strings; i++)
+		dump_strings[i] = get_string(f);
+
+	rewind(f);
+	get_magic(f, DISSECT_MAGIC, name);
+	if (*query) {
+		dump_query(f, name, query);
+	} else {
+		while (ftell(f) < offset) {
+			int j, nr = read_block(f);
+
+			for (j = 0; j < nr; j++)
+				print_report(reports + j);
+		}
+	}
+	fclose(f);
+}
+
+static void merge_records(char *file, FILE *data)
+{
+	int c;
+
+	while ((c = getc(data)) != EOF) {
+		char *stream, *name, *member = NULL, *type;
+		unsigned int mode, line, col;
+		char storage;
+		int names;
+
+		ungetc(c, data);
+		mode = get_varint(data);
+		storage = getc(data);
+		stream = get_string(data);
+		line = get_varint(data);
+		col = get_varint(data);
+		names = getc(data);
+		name = get_string(data);
+		if (names == 2)
+			member = get_string(data);
+		type = get_string(data);
+		number_report(mode, storage, stream, line, col, name, member, type);
+		free(stream);
+		free(name);
+		free(member);
+		free(type);
+	}
+}
+
+static struct reporter *reporter;
+
+static void dissect_file(char *file)
+{
+	dotc_stream = input_stream_nr;
+	dissect(__sparse(file), reporter);
+}
+
+static void dissect_worker(char *file, int nr, FILE *data)
+{
+	if (dissect_binary)
+		records = data;
+	dissect_file(file);
+}
+
 int main(int argc, char **argv)
 {
-	static struct reporter reporter = {
+	static struct reporter text_reporter = {
 		.r_symdef = r_symdef,
 		.r_symbol = r_symbol,
 		.r_member = r_member,
 	};
+	static struct reporter binary_reporter = {
+		.r_symdef = b_symdef,
+		.r_symbol = b_symbol,
+		.r_member = b_member,
+	};
 	struct string_list *filelist = NULL;
 	char *file;
 
 	sparse_initialize(argc, argv, &filelist);
+	if (dissect_dump && !dissect_binary)
+		die("-fdissect-dump needs -fdissect-binary=FILE");
+	if (dissect_dump && !filelist) {
+		dump_binary(dissect_binary, dissect_dump);
+		return 0;
+	}
+	reporter = &text_reporter;
+	if (dissect_binary) {
+		open_binary(dissect_binary);
+		reporter = &binary_reporter;
+	}
 
-	FOR_EACH_PTR_NOTAG(filelist, file) {
-		dotc_stream = input_stream_nr;
-		dissect(__sparse(file), &reporter);
-	} END_FOR_EACH_PTR_NOTAG(file);
+	if (parallel_jobs) {
+		run_workers(filelist, dissect_worker,
+			    dissect_binary ? merge_records : NULL);
+	} else {
+		FOR_EACH_PTR_NOTAG(filelist, file) {
+			dissect_file(file);
+		} END_FOR_EACH_PTR_NOTAG(file);
+	}
 
+	if (dissect_binary)
+		close_binary(dissect_binary);
+	if (dissect_dump)
+		dump_binary(dissect_binary, dissect_dump);
 	return 0;
 }
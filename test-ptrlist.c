@@ -0,0 +1,140 @@
+/*
+ * Micro-benchmark for the two pointer list flavours.
+ *
+ * Mimics the FOR_EACH_PTR-heavy loops of cse.c (hash, stable
+ * sort and scan of instruction buckets) and liveness.c (linear
+ * membership tests against pseudo lists), once over node based
+ * ptr-lists and once over vector backed ones.
+ *
+ *   ./test-ptrlist [nr-entries [rounds]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "lib.h"
+#include "allocate.h"
+
+struct entry {
+	int key;
+};
+
+DECLARE_PTR_LIST(entry_list, struct entry);
+DECLARE_PTR_VEC(entry_vec, struct entry);
+
+static int entry_cmp(const void *_a, const void *_b)
+{
+	const struct entry *a = _a, *b = _b;
+	return a->key < b->key ? -1 : a->key > b->key;
+}
+
+static double now(void)
+{
+	return (double) clock() / CLOCKS_PER_SEC;
+}
+
+static int list_member(struct entry_list *list, struct entry *e)
+{
+	struct entry *p;
+	FOR_EACH_PTR(list, p) {
+		if (p == e)
+			return 1;
+	} END_FOR_EACH_PTR(p);
+	return 0;
+}
+
+static int vec_member(struct entry_vec *vec, struct entry *e)
+{
+	struct entry *p;
+	FOR_EACH_VEC(vec, p) {
+		if (p == e)
+			return 1;
+	} END_FOR_EACH_VEC(p);
+	return 0;
+}
+
+static void bench_list(struct entry **entries, int nr, int rounds)
+{
+	struct entry_list *list = NULL;
+	double t0, t1, t2;
+	long sum = 0;
+	int i, r;
+
+	t0 = now();
+	for (r = 0; r < rounds; r++) {
+		struct entry *e, *last = NULL;
+		for (i = 0; i < nr; i++)
+			add_ptr_list(&list, entries[i]);
+		sort_list((struct ptr_list **)&list, entry_cmp);
+		FOR_EACH_PTR(list, e) {
+			if (last && !entry_cmp(last, e))
+				sum++;
+			last = e;
+		} END_FOR_EACH_PTR(e);
+		sum += ptr_list_size((struct ptr_list *)list);
+		free_ptr_list(&list);
+	}
+	t1 = now();
+	for (i = 0; i < nr; i++)
+		add_ptr_list(&list, entries[i]);
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < nr; i += 16)
+			sum += list_member(list, entries[nr - 1 - i]);
+	t2 = now();
+	free_ptr_list(&list);
+	printf("ptr_list: cse-like %.3fs, liveness-like %.3fs (%ld)\n",
+		t1 - t0, t2 - t1, sum);
+}
+
+static void bench_vec(struct entry **entries, int nr, int rounds)
+{
+	struct entry_vec vec = { };
+	double t0, t1, t2;
+	long sum = 0;
+	int i, r;
+
+	t0 = now();
+	for (r = 0; r < rounds; r++) {
+		struct entry *e, *last = NULL;
+		for (i = 0; i < nr; i++)
+			add_ptr_vec(&vec, entries[i]);
+		SORT_PTR_VEC(&vec, entry_cmp);
+		FOR_EACH_VEC(&vec, e) {
+			if (last && !entry_cmp(last, e))
+				sum++;
+			last = e;
+		} END_FOR_EACH_VEC(e);
+		sum += ptr_vec_size(&vec);
+		reset_ptr_vec(&vec);
+	}
+	t1 = now();
+	for (i = 0; i < nr; i++)
+		add_ptr_vec(&vec, entries[i]);
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < nr; i += 16)
+			sum += vec_member(&vec, entries[nr - 1 - i]);
+	t2 = now();
+	free_ptr_vec(&vec);
+	printf("ptr_vec:  cse-like %.3fs, liveness-like %.3fs (%ld)\n",
+		t1 - t0, t2 - t1, sum);
+}
+
+int main(int argc, char **argv)
+{
+	int nr = argc > 1 ? atoi(argv[1]) : 20000;
+	int rounds = argc > 2 ? atoi(argv[2]) : 20;
+	struct entry **entries;
+	int i;
+
+	entries = malloc(nr * sizeof(*entries));
+	srand(nr);
+	for (i = 0; i < nr; i++) {
+		entries[i] = malloc(sizeof(struct entry));
+		entries[i]->key = rand() % (nr / 4 + 1);
+	}
+
+	printf("%d entries, %d rounds, LIST_NODE_NR=%d\n", nr, rounds, LIST_NODE_NR);
+	bench_list(entries, nr, rounds);
+	bench_vec(entries, nr, rounds);
+	return 0;
+}
@@ -2,6 +2,7 @@
 #include "allocate.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 static int
 int_cmp (const void *_a, const void *_b)
@@ -13,6 +14,93 @@ int_cmp (const void *_a, const void *_b)
 
 #define MIN(_x,_y) ((_x) < (_y) ? (_x) : (_y))
 
+struct item {
+  int key;
+  int seq;
+};
+
+static int
+item_cmp (const void *_a, const void *_b)
+{
+  const struct item *a = _a;
+  const struct item *b = _b;
+  return a->key - b->key;
+}
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Sort the same big list (lots of duplicate keys) with 1 and with
+// 'threads' threads: the results must be sorted, stable and identical.
+static void
+bench_parallel (int N, int threads)
+{
+  struct ptr_list *l[2] = { NULL, NULL };
+  struct ptr_vec vec = { };
+  struct item *items;
+  void *a, *b, *prev;
+  double t[3];
+  int i, pass;
+
+  items = malloc (N * sizeof (*items));
+  for (i = 0; i < N; i++) {
+    items[i].key = rand () % (N / 8 + 1);
+    items[i].seq = i;
+    __add_ptr_list (&l[0], &items[i], 0);
+    __add_ptr_list (&l[1], &items[i], 0);
+    __add_ptr_vec (&vec, &items[i]);
+  }
+
+  for (pass = 0; pass < 2; pass++) {
+    double start = now ();
+    sort_threads = pass ? threads : 1;
+    sort_list (&l[pass], item_cmp);
+    t[pass] = now () - start;
+  }
+  t[2] = now ();
+  sort_vec (&vec, item_cmp);
+  t[2] = now () - t[2];
+
+  if (ptr_list_size (l[0]) != N || ptr_list_size (l[1]) != N) {
+    fprintf (stderr, "size mismatch after sort\n");
+    exit (1);
+  }
+
+  prev = NULL;
+  i = 0;
+  PREPARE_PTR_LIST (l[1], b);
+  FOR_EACH_PTR (l[0], a) {
+    const struct item *x = prev, *y = a;
+    if (a != b) {
+      fprintf (stderr, "parallel sort differs from serial sort\n");
+      exit (1);
+    }
+    if (x && (x->key > y->key || (x->key == y->key && x->seq > y->seq))) {
+      fprintf (stderr, "sort is not stable\n");
+      exit (1);
+    }
+    if (a != vec.list[i++]) {
+      fprintf (stderr, "vector sort differs from list sort\n");
+      exit (1);
+    }
+    prev = a;
+    NEXT_PTR_LIST (b);
+  } END_FOR_EACH_PTR (a);
+  FINISH_PTR_LIST (b);
+
+  printf ("%d entries: 1 thread %.3fs, %d threads %.3fs, vector %.3fs\n",
+	  N, t[0], threads, t[1], t[2]);
+  free_ptr_list (&l[0]);
+  free_ptr_list (&l[1]);
+  __free_ptr_vec (&vec);
+  free (items);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -27,7 +115,7 @@ main (int argc, char **argv)
   for (i = 0; i < N; i++) {
     e = (int *)malloc (sizeof (int));
     *e = rand ();
-    add_ptr_list (&l, e);
+    __add_ptr_list (&l, e, 0);
   }
   sort_list (&l, int_cmp);
   // Sort already sorted stuff.
@@ -42,5 +130,8 @@ main (int argc, char **argv)
   } while (l2 != l);
   sort_list (&l, int_cmp);
 
+  // Big enough to take the parallel path.
+  bench_parallel (argv[1] && argv[2] ? atoi (argv[2]) : 200000, 4);
+
   return 0;
 }
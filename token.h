@@ -67,9 +67,12 @@ extern struct stream *input_streams;
 extern unsigned int tabstop;
 extern int *hash_stream(const char *name);
 
+/* The namespace classes of ident_symbols(), see symbol.h */
+#define NS_CLASSES	6
+
 struct ident {
 	struct ident *next;	/* Hash chain of identifiers */
-	struct symbol *symbols;	/* Pointer to semantic meaning list */
+	struct symbol *symbols[NS_CLASSES]; /* Semantic meanings, per namespace class */
 	unsigned char len;	/* Length of identifier name */
 	unsigned char tainted:1,
 	              reserved:1,
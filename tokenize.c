@@ -845,7 +845,7 @@ void show_identifier_stats(void)
 static struct ident *alloc_ident(const char *name, int len)
 {
 	struct ident *ident = __alloc_ident(len);
-	ident->symbols = NULL;
+	memset(ident->symbols, 0, sizeof(ident->symbols));
 	ident->len = len;
 	ident->tainted = 0;
 	memcpy(ident->name, name, len);
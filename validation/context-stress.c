@@ -0,0 +1,68 @@
+static void a(void) __attribute__((context(0,1)))
+{
+	__context__(1);
+}
+
+static void r(void) __attribute__((context(1,0)))
+{
+	__context__(-1);
+}
+
+extern int condition, condition2;
+
+/* Lots of paths, all meeting again with the same context */
+#define BOTH	if (condition) { a(); r(); } else { a(); condition2 = 1; r(); }
+#define SPLIT	if (condition) a(); else a(); if (condition2) r(); else r();
+
+#define X4(x)	x x x x
+#define X16(x)	X4(X4(x))
+#define X256(x)	X16(X16(x))
+
+static void good_stress1(void)
+{
+	X256(BOTH)
+	X256(BOTH)
+}
+
+static void good_stress2(void)
+{
+	X256(SPLIT)
+}
+
+static void good_stress3(void)
+{
+	a();
+	while (condition) {
+		X256(SPLIT)
+	}
+	r();
+}
+
+static void warn_stress1(void)
+{
+	X256(SPLIT)
+	if (condition)
+		a();
+	X256(SPLIT)
+}
+
+static void warn_stress2(void)
+{
+	X256(BOTH)
+	a();
+	while (condition) {
+		X16(SPLIT)
+		if (condition2)
+			break;
+		r();
+	}
+}
+
+/*
+ * check-name: Check -Wcontext with many paths
+ *
+ * check-error-start
+context-stress.c:46:9: warning: context imbalance in 'warn_stress1' - wrong count at exit
+context-stress.c:53:9: warning: context imbalance in 'warn_stress2' - wrong count at exit
+ * check-error-end
+ */
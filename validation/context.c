@@ -314,6 +314,119 @@ static void warn_cond_lock1(void)
         condition2 = 1; /* do stuff */
     r();
 }
+
+static void good_switch1(void)
+{
+    a();
+    switch (condition) {
+    case 0:
+        r();
+        break;
+    case 1:
+        condition2 = 1;
+        /* fall through */
+    default:
+        r();
+        break;
+    }
+}
+
+static void warn_switch1(void)
+{
+    a();
+    switch (condition) {
+    case 0:
+        r();
+        break;
+    case 1:
+        break;
+    default:
+        r();
+        break;
+    }
+}
+
+static void good_nested1(void)
+{
+    while (condition) {
+        a();
+        while (condition2) {
+            a();
+            r();
+        }
+        r();
+    }
+}
+
+static void warn_nested1(void)
+{
+    while (condition) {
+        a();
+        while (condition2) {
+            a();
+            if (condition)
+                continue;
+            r();
+        }
+        r();
+    }
+}
+
+static int good_return1(void)
+{
+    a();
+    if (condition) {
+        r();
+        return 1;
+    }
+    if (condition2) {
+        r();
+        return 2;
+    }
+    r();
+    return 0;
+}
+
+static int warn_return1(void)
+{
+    a();
+    if (condition) {
+        r();
+        return 1;
+    }
+    if (condition2)
+        return 2;
+    r();
+    return 0;
+}
+
+static void good_paths1(void)
+{
+    if (condition)
+        a();
+    else
+        a();
+    if (condition2)
+        r();
+    else
+        r();
+}
+
+static void warn_paths1(void)
+{
+    if (condition)
+        a();
+    if (condition2)
+        r();
+}
+
+static void good_cond_lock2(void)
+{
+    while (!ca(condition))
+        ;
+    r();
+}
+
 /*
  * check-name: Check -Wcontext
  *
@@ -332,5 +445,9 @@ context.c:274:13: warning: context imbalance in 'warn_goto1' - wrong count at ex
 context.c:283:13: warning: context imbalance in 'warn_goto2' - wrong count at exit
 context.c:300:5: warning: context imbalance in 'warn_goto3' - different lock contexts for basic block
 context.c:315:5: warning: context imbalance in 'warn_cond_lock1' - different lock contexts for basic block
+context.c:337:5: warning: context imbalance in 'warn_switch1' - different lock contexts for basic block
+context.c:365:9: warning: context imbalance in 'warn_nested1' - different lock contexts for basic block
+context.c:390:12: warning: context imbalance in 'warn_return1' - different lock contexts for basic block
+context.c:419:5: warning: context imbalance in 'warn_paths1' - different lock contexts for basic block
  * check-error-end
  */
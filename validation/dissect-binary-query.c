@@ -0,0 +1,30 @@
+struct pair {
+	int a, b;
+};
+
+static struct pair p;
+int count;
+
+static int get(struct pair *q)
+{
+	return q->a + p.b;
+}
+
+int bump(void)
+{
+	p.a = get(&p);
+	return count++;
+}
+
+/*
+ * check-name: dissect binary index lookup of a member
+ * check-command: test-dissect -fdissect-binary=$file.dissect -fdissect-dump=pair.a $file
+ *
+ * check-output-start
+
+FILE: dissect-binary-query.c
+
+  10:17  s -r-  pair.a                           int
+  15:10  s -w-  pair.a                           int
+ * check-output-end
+ */
@@ -0,0 +1,43 @@
+struct pair {
+	int a, b;
+};
+
+static struct pair p;
+int count;
+
+static int get(struct pair *q)
+{
+	return q->a + p.b;
+}
+
+int bump(void)
+{
+	p.a = get(&p);
+	return count++;
+}
+
+/*
+ * check-name: dissect binary output read back as the text report
+ * check-command: test-dissect -fdissect-binary=$file.dissect -fdissect-dump $file
+ *
+ * check-output-start
+
+FILE: dissect-binary.c
+
+   1:8   s def  pair                             
+   5:20  s def  p                                struct pair
+   6:5   g def  count                            int
+   8:12  s def  get                              int ( ... )
+   8:16  l def  q                                struct pair *
+  10:16  l --r  q                                struct pair *
+  10:17  s -r-  pair.a                           int
+  10:23  s -r-  p                                struct pair
+  10:24  s -r-  pair.b                           int
+  13:5   g def  bump                             int ( ... )
+  15:9   s -w-  p                                struct pair
+  15:10  s -w-  pair.a                           int
+  15:15  s --r  get                              int ( ... )
+  15:20  s m--  p                                struct pair
+  16:16  g -m-  count                            int
+ * check-output-end
+ */
@@ -0,0 +1,64 @@
+static int guarded_div(int k, int a, int b)
+{
+	int r = 0;
+
+	switch (k) {
+	case 1:
+		if (b)
+			r = a / b;
+		break;
+	case 2:
+		if (b)
+			r = a / b + 1;
+		break;
+	}
+	return r;
+}
+
+/*
+ * check-name: CSE must not hoist a guarded division
+ * check-command: test-linearize $file
+ *
+ * check-output-start
+guarded_div:
+.L1:
+	<entry-point>
+	phisrc.32   %phi6(r) <- $0
+	switch      %arg1, 1 -> .L3, 2 -> .L4, default -> .L2
+
+.L3:
+	phisrc.32   %phi7(r) <- $0
+	br          %arg3, .L5, .L6
+
+.L5:
+	divs.32     %r5 <- %arg2, %arg3
+	phisrc.32   %phi8(r) <- %r5
+	br          .L6
+
+.L6:
+	phi.32      %r15 <- %phi7(r), %phi8(r)
+	phisrc.32   %phi4(r) <- %r15
+	br          .L2
+
+.L4:
+	phisrc.32   %phi2(r) <- $0
+	br          %arg3, .L7, .L8
+
+.L7:
+	divs.32     %r9 <- %arg2, %arg3
+	add.32      %r10 <- %r9, $1
+	phisrc.32   %phi3(r) <- %r10
+	br          .L8
+
+.L8:
+	phi.32      %r13 <- %phi2(r), %phi3(r)
+	phisrc.32   %phi5(r) <- %r13
+	br          .L2
+
+.L2:
+	phi.32      %r14 <- %phi4(r), %phi5(r), %phi6(r)
+	ret.32      %r14
+
+
+ * check-output-end
+ */
@@ -0,0 +1,69 @@
+static int div_zero(int a, int n)
+{
+	int z = 0;
+
+	while (n--) {
+		if (z)
+			z = 1;
+	}
+	return a / z;
+}
+
+static int const_div_zero(int n)
+{
+	int z = 0;
+
+	while (n--) {
+		if (z)
+			z = 1;
+	}
+	return 8 / z;
+}
+
+/*
+ * check-name: SCCP leaves divisions by zero alone
+ * check-command: test-linearize -fsccp $file
+ *
+ * check-output-start
+div_zero:
+.L1:
+	<entry-point>
+	phisrc.32   %phi2(n) <- %arg2
+	br          .L5
+
+.L5:
+	phi.32      %r8 <- %phi2(n), %phi3(n)
+	add.32      %r2 <- %r8, $-1
+	br          %r8, .L3, .L4
+
+.L3:
+	phisrc.32   %phi3(n) <- %r2
+	br          .L5
+
+.L4:
+	divs.32     %r6 <- %arg1, $0
+	ret.32      %r6
+
+
+const_div_zero:
+.L1:
+	<entry-point>
+	phisrc.32   %phi9(n) <- %arg1
+	br          .L5
+
+.L5:
+	phi.32      %r17 <- %phi9(n), %phi10(n)
+	add.32      %r12 <- %r17, $-1
+	br          %r17, .L3, .L4
+
+.L3:
+	phisrc.32   %phi10(n) <- %r12
+	br          .L5
+
+.L4:
+	divs.32     %r15 <- $8, $0
+	ret.32      %r15
+
+
+ * check-output-end
+ */
@@ -0,0 +1,76 @@
+extern void never(void);
+
+/* x can only stay 1: SCCP sees through the loop phi */
+static int loop_phi(int n)
+{
+	int x = 1;
+
+	while (n--) {
+		if (x != 1)
+			x = 2;
+	}
+	return x;
+}
+
+/* the branches on x become unconditional, and never() goes away */
+static int dead_branch(int n)
+{
+	int x = 1;
+
+	while (n--) {
+		if (x != 1) {
+			never();
+			x = 2;
+		}
+	}
+	if (x == 1)
+		return 10;
+	never();
+	return 20;
+}
+
+/*
+ * check-name: SCCP through loop phis and constant branches
+ * check-command: test-linearize -fsccp $file
+ *
+ * check-output-start
+loop_phi:
+.L1:
+	<entry-point>
+	phisrc.32   %phi2(n) <- %arg1
+	br          .L5
+
+.L5:
+	phi.32      %r7 <- %phi2(n), %phi3(n)
+	add.32      %r2 <- %r7, $-1
+	br          %r7, .L3, .L8
+
+.L3:
+	phisrc.32   %phi3(n) <- %r2
+	br          .L5
+
+.L8:
+	ret.32      $1
+
+
+dead_branch:
+.L1:
+	<entry-point>
+	phisrc.32   %phi10(n) <- %arg1
+	br          .L5
+
+.L5:
+	phi.32      %r17 <- %phi10(n), %phi11(n)
+	add.32      %r11 <- %r17, $-1
+	br          %r17, .L3, .L10
+
+.L3:
+	phisrc.32   %phi11(n) <- %r11
+	br          .L5
+
+.L10:
+	ret.32      $10
+
+
+ * check-output-end
+ */
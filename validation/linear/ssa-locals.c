@@ -0,0 +1,192 @@
+extern void use(int *p);
+
+static int join(int a, int b)
+{
+	int r;
+
+	if (a)
+		r = b;
+	else
+		r = b + 1;
+	return r;
+}
+
+static int sum(int n)
+{
+	int i, s = 0;
+
+	for (i = 0; i < n; i++)
+		s += i;
+	return s;
+}
+
+static int state_machine(const char *p)
+{
+	int state = 0, n = 0;
+
+	while (*p) {
+		switch (state) {
+		case 0:
+			if (*p == 'a')
+				state = 1;
+			break;
+		case 1:
+			n++;
+			state = *p == 'b' ? 2 : 0;
+			break;
+		case 2:
+			state = 0;
+			break;
+		}
+		p++;
+	}
+	return n + state;
+}
+
+static int uninitialized(int a)
+{
+	int r;
+
+	if (a)
+		r = 1;
+	return r;
+}
+
+static int addressed(int a)
+{
+	int r = a;
+
+	use(&r);
+	if (a)
+		r = 2;
+	return r;
+}
+
+/*
+ * check-name: SSA construction for local variables
+ * check-command: test-linearize $file
+ *
+ * check-output-start
+join:
+.L1:
+	<entry-point>
+	br          %arg1, .L2, .L3
+
+.L2:
+	phisrc.32   %phi2(r) <- %arg2
+	br          .L4
+
+.L3:
+	add.32      %r4 <- %arg2, $1
+	phisrc.32   %phi3(r) <- %r4
+	br          .L4
+
+.L4:
+	phi.32      %r7 <- %phi2(r), %phi3(r)
+	ret.32      %r7
+
+
+sum:
+.L1:
+	<entry-point>
+	phisrc.32   %phi5(s) <- $0
+	phisrc.32   %phi7(i) <- $0
+	br          .L5
+
+.L5:
+	phi.32      %r21 <- %phi7(i), %phi8(i)
+	phi.32      %r20 <- %phi5(s), %phi6(s)
+	setlt.32    %r10 <- %r21, %arg1
+	br          %r10, .L2, .L6
+
+.L2:
+	add.32      %r14 <- %r20, %r21
+	add.32      %r17 <- %r21, $1
+	phisrc.32   %phi6(s) <- %r14
+	phisrc.32   %phi8(i) <- %r17
+	br          .L5
+
+.L6:
+	ret.32      %r20
+
+
+state_machine:
+.L1:
+	<entry-point>
+	phisrc.64   %phi10(p) <- %arg1
+	phisrc.32   %phi16(state) <- $0
+	phisrc.32   %phi24(n) <- $0
+	br          .L5
+
+.L5:
+	phi.32      %r47 <- %phi24(n), %phi25(n)
+	phi.32      %r44 <- %phi16(state), %phi17(state)
+	phi.64      %r42 <- %phi10(p), %phi11(p)
+	load.8      %r23 <- 0[%r42]
+	br          %r23, .L2, .L4
+
+.L2:
+	phisrc.32   %phi15(state) <- %r44
+	phisrc.32   %phi23(n) <- %r47
+	switch      %r44, 0 -> .L7, 1 -> .L8, 2 -> .L9, default -> .L6
+
+.L7:
+	scast.32    %r27 <- (8) %r23
+	seteq.32    %r28 <- %r27, $97
+	select.32   %r45 <- %r28, $1, %r44
+	phisrc.32   %phi12(state) <- %r45
+	phisrc.32   %phi20(n) <- %r47
+	br          .L6
+
+.L8:
+	add.32      %r30 <- %r47, $1
+	scast.32    %r33 <- (8) %r23
+	seteq.32    %r34 <- %r33, $98
+	select.32   %r35 <- %r34, $2, $0
+	phisrc.32   %phi13(state) <- %r35
+	phisrc.32   %phi21(n) <- %r30
+	br          .L6
+
+.L9:
+	phisrc.32   %phi14(state) <- $0
+	phisrc.32   %phi22(n) <- %r47
+	br          .L6
+
+.L6:
+	phi.32      %r46 <- %phi20(n), %phi21(n), %phi22(n), %phi23(n)
+	phi.32      %r43 <- %phi12(state), %phi13(state), %phi14(state), %phi15(state)
+	add.64      %r37 <- %r42, $1
+	phisrc.64   %phi11(p) <- %r37
+	phisrc.32   %phi17(state) <- %r43
+	phisrc.32   %phi25(n) <- %r46
+	br          .L5
+
+.L4:
+	add.32      %r40 <- %r47, %r44
+	ret.32      %r40
+
+
+uninitialized:
+.L1:
+	<entry-point>
+	ret.32      $1
+
+
+addressed:
+.L1:
+	<entry-point>
+	store.32    %arg1 -> 0[r]
+	call        use, r
+	br          %arg1, .L2, .L3
+
+.L2:
+	store.32    $2 -> 0[r]
+	br          .L3
+
+.L3:
+	load.32     %r54 <- 0[r]
+	ret.32      %r54
+
+
+ * check-output-end
+ */
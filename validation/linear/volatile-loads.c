@@ -0,0 +1,82 @@
+extern volatile int g;
+struct s { volatile int v; int w; };
+
+static int vglobal(void)
+{
+	return g + g;
+}
+
+static int vptr(volatile int *p)
+{
+	return *p + *p;
+}
+
+static int vmember(struct s *s)
+{
+	return s->v + s->v;
+}
+
+static int plain(int *p)
+{
+	return *p + *p;
+}
+
+static int vlocal(int a)
+{
+	volatile int x = a;
+
+	return x + x;
+}
+
+/*
+ * check-name: volatile loads are never merged
+ * check-command: test-linearize $file
+ *
+ * check-output-start
+vglobal:
+.L1:
+	<entry-point>
+	load.32     %r1 <- 0[g]
+	load.32     %r3 <- 0[g]
+	add.32      %r5 <- %r1, %r3
+	ret.32      %r5
+
+
+vptr:
+.L1:
+	<entry-point>
+	load.32     %r8 <- 0[%arg1]
+	load.32     %r11 <- 0[%arg1]
+	add.32      %r13 <- %r8, %r11
+	ret.32      %r13
+
+
+vmember:
+.L1:
+	<entry-point>
+	load.32     %r16 <- 0[%arg1]
+	load.32     %r19 <- 0[%arg1]
+	add.32      %r21 <- %r16, %r19
+	ret.32      %r21
+
+
+plain:
+.L1:
+	<entry-point>
+	load.32     %r24 <- 0[%arg1]
+	add.32      %r27 <- %r24, %r24
+	ret.32      %r27
+
+
+vlocal:
+.L1:
+	<entry-point>
+	store.32    %arg1 -> 0[x]
+	load.32     %r31 <- 0[x]
+	load.32     %r33 <- 0[x]
+	add.32      %r35 <- %r31, %r33
+	ret.32      %r35
+
+
+ * check-output-end
+ */
@@ -0,0 +1,60 @@
+extern void *memset(void *s, int c, unsigned long n);
+extern void take(int *p);
+extern void lock(void) __attribute__((context(x, 0, 1)));
+extern void unlock(void) __attribute__((context(x, 1, 0)));
+
+struct pair {
+	int a, b;
+};
+
+static int skipped(int a, struct pair *p)
+{
+	int v[2] = { a, a << 2 };
+
+	take(v);
+	if (p->a > v[1])
+		return p->b;
+	return v[0] + v[1];
+}
+
+static void balanced(void)
+{
+	lock();
+	unlock();
+}
+
+static void imbalance(void)
+{
+	lock();
+}
+
+static int shift(int a)
+{
+	int n = 40;
+
+	return a >> n;
+}
+
+static int past_end(void)
+{
+	int v[2] = { 1, 2 };
+
+	return v[3];
+}
+
+static void clear(int *p)
+{
+	memset(p, 0, 200000);
+}
+
+/*
+ * check-name: -flinearize-all checks every function
+ * check-command: sparse -flinearize-all $file
+ *
+ * check-error-start
+linearize-all.c:26:13: warning: context imbalance in 'imbalance' - wrong count at exit
+linearize-all.c:35:18: warning: shift too big (40) for type int
+linearize-all.c:42:17: warning: invalid access past the end of 'v' (12 8)
+linearize-all.c:47:15: warning: memset with byte count of 200000
+ * check-error-end
+ */
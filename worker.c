@@ -0,0 +1,156 @@
+/*
+ * Run the files of the command line in worker processes.
+ *
+ * The front end is full of global state, so the parallelism is one
+ * process per file, forked once the command line has been handled:
+ * each worker does one file, with its standard output and error and
+ * a data file of its own redirected to temporary files, and takes its
+ * memory with it when it exits. Their outputs are replayed in the
+ * order of the files, so the result doesn't depend on -fjobs.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "lib.h"
+
+struct worker {
+	pid_t pid;
+	int status, done;
+	FILE *out, *err, *data;
+};
+
+static FILE *worker_tmpfile(void)
+{
+	FILE *f = tmpfile();
+	if (!f)
+		die("can't create temporary file: %s", strerror(errno));
+	return f;
+}
+
+static void limit_worker_memory(void)
+{
+	struct rlimit rl;
+
+	if (!worker_memory)
+		return;
+	rl.rlim_cur = rl.rlim_max = (rlim_t)worker_memory << 20;
+	if (setrlimit(RLIMIT_AS, &rl))
+		die("can't limit the memory of a worker: %s", strerror(errno));
+}
+
+static void start_worker(struct worker *w, char *file, int nr,
+			 void (*work)(char *, int, FILE *))
+{
+	w->out = worker_tmpfile();
+	w->err = worker_tmpfile();
+	w->data = worker_tmpfile();
+
+	/* Nothing buffered must be written twice */
+	fflush(NULL);
+	w->pid = fork();
+	if (w->pid < 0)
+		die("can't fork: %s", strerror(errno));
+	if (w->pid)
+		return;
+
+	dup2(fileno(w->out), STDOUT_FILENO);
+	dup2(fileno(w->err), STDERR_FILENO);
+	limit_worker_memory();
+	work(file, nr, w->data);
+	fflush(w->data);
+	exit(0);
+}
+
+static void copy_file(FILE *from, FILE *to)
+{
+	char buf[8192];
+	size_t n;
+
+	rewind(from);
+	while ((n = fread(buf, 1, sizeof(buf), from)) > 0)
+		fwrite(buf, 1, n, to);
+	fclose(from);
+}
+
+static void merge_worker(struct worker *w, char *file,
+			 void (*merge)(char *, FILE *))
+{
+	copy_file(w->out, stdout);
+	copy_file(w->err, stderr);
+
+	if (!WIFEXITED(w->status) || WEXITSTATUS(w->status))
+		die("worker for %s failed", file);
+
+	rewind(w->data);
+	if (merge)
+		merge(file, w->data);
+	fclose(w->data);
+}
+
+/*
+ * "work" is called in the worker with the file, its index and the data
+ * file, "merge" (if any) in the parent with the data of each worker in
+ * the order of the files. A failed worker is fatal.
+ */
+void run_workers(struct string_list *filelist,
+		 void (*work)(char *file, int nr, FILE *data),
+		 void (*merge)(char *file, FILE *data))
+{
+	int nr = ptr_list_size((struct ptr_list *)filelist);
+	struct worker *workers = calloc(nr, sizeof(*workers));
+	char **files = malloc(nr * sizeof(*files));
+	int started = 0, merged = 0, running = 0;
+	char *file;
+
+	if (nr && (!workers || !files))
+		die("out of memory");
+	FOR_EACH_PTR_NOTAG(filelist, file) {
+		files[started++] = file;
+	} END_FOR_EACH_PTR_NOTAG(file);
+
+	started = 0;
+	while (merged < nr) {
+		int status, i;
+		pid_t pid;
+
+		/*
+		 * The outputs of a finished worker stay open until all the
+		 * files before it are merged: don't run too far ahead of a
+		 * slow one, or they could eat all the file descriptors.
+		 */
+		while (started < nr && running < parallel_jobs &&
+		       started < merged + 2 * parallel_jobs) {
+			start_worker(workers + started, files[started], started, work);
+			started++;
+			running++;
+		}
+
+		pid = wait(&status);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			die("wait: %s", strerror(errno));
+		}
+		for (i = merged; i < started; i++) {
+			if (workers[i].pid == pid) {
+				workers[i].status = status;
+				workers[i].done = 1;
+				running--;
+				break;
+			}
+		}
+
+		while (merged < started && workers[merged].done) {
+			merge_worker(workers + merged, files[merged], merge);
+			merged++;
+		}
+	}
+	free(workers);
+	free(files);
+}